@@ -1,7 +1,14 @@
 #include "AI.hpp"
+#include "ProofNumber.hpp"
+#include "PerfectPlay.hpp"
+#include "ThreatSpace.hpp"
+#include "TranspositionTable.hpp"
+#include "Profiling.hpp"
 #include <algorithm>
+#include <cstdint>
 #include <stdexcept>
 #include <limits>
+#include <utility>
 
 Score defaultEvaluator(const GameState& gameState, const Symbol symbol)
 {
@@ -52,35 +59,109 @@ Score improvedEvaluator(const GameState& gameState, const Symbol symbol)
 	return score;
 }
 
+namespace
+{
+	std::atomic<TranspositionTable*> transpositionTable(nullptr);
+	
+	// The phases of a search, each one counted separately when profiling.
+	std::vector<Action> generateMoves(const GameState& state, const Symbol symbol)
+	{
+		PhaseScope phase(SearchPhase::MOVE_GENERATION);
+		return state.possibleActionsFor(symbol);
+	}
+	
+	GameState applyMove(const GameState& state, const Action action)
+	{
+		PhaseScope phase(SearchPhase::APPLY);
+		return state.apply(action);
+	}
+	
+	bool checkTerminal(const GameState& state)
+	{
+		PhaseScope phase(SearchPhase::TERMINAL_CHECK);
+		return state.terminal();
+	}
+	
+	Score evaluateLeaf(Evaluator evaluate, const GameState& state, const Symbol symbol)
+	{
+		PhaseScope phase(SearchPhase::EVALUATION);
+		return evaluate(state, symbol);
+	}
+	
+	// Identifies a search for the transposition table, or returns 0 if evaluate's
+	// results can't be remembered.  Two bits per space, then symbol, then evaluate.
+	std::uint64_t tableKey(const GameState& state, Evaluator evaluate, const Symbol symbol)
+	{
+		const std::uint64_t evaluator = evaluate == defaultEvaluator ? 1 : evaluate == improvedEvaluator ? 2 : 0;
+		if (evaluator == 0) return 0;
+		
+		std::uint64_t key = evaluator << 33 | std::uint64_t(symbol == Symbol::O) << 32;
+		for (std::size_t place = 0; place < state.symbols.size(); place++)
+			key |= std::uint64_t(state.symbols[place]) << 2*place;
+		return key;
+	}
+}
+
+void useTranspositionTable(TranspositionTable* const table)
+{
+	transpositionTable = table;
+}
+
 MinimaxResult minimax(const GameState& state,
                       Evaluator evaluate,
                       const Symbol symbol,
                       const unsigned int maximumDepth,
                       const Score minimum,
-                      const Score maximum)
+                      const Score maximum,
+                      const std::atomic<bool>* const cancelled)
 {
 	MinimaxResult result;
 	
-	const auto ourActions = state.possibleActionsFor(symbol);
+	if (cancelled && *cancelled)
+	{
+		result.cutOff = true;
+		return result;
+	}
+	
+	const auto ourActions = generateMoves(state, symbol);
 	
-	if (maximumDepth == 0 || state.terminal() || ourActions.empty()) // This is either a leaf node or we've reached the cutoff point.
+	if (maximumDepth == 0 || checkTerminal(state) || ourActions.empty()) // This is either a leaf node or we've reached the cutoff point.
 	{
-		result.score = evaluate(state, symbol);
+		result.score = evaluateLeaf(evaluate, state, symbol);
 		result.cutOff = !ourActions.empty(); // It doesn't count as a cutoff if there are no child nodes, anyway.
 	}
 	
 	else
 	{
+		// A remembered result is as good as a new one if it was searched just as
+		// deep, or if its search never hit the depth limit, since searching deeper
+		// wouldn't change anything then.  A lower bound is only good enough if it
+		// proves that we'd be pruned again.
+		TranspositionTable* const table = transpositionTable;
+		const std::uint64_t key = table ? tableKey(state, evaluate, symbol) : 0;
+		TableEntry entry;
+		if (key != 0 && table->lookup(key, entry)
+		    && (entry.depth == maximumDepth || (!entry.cutOff && entry.depth <= maximumDepth))
+		    && (!entry.lowerBound || entry.score > maximum))
+		{
+			result.score = entry.score;
+			result.cutOff = entry.cutOff;
+			result.maximumDepth = entry.maximumDepth;
+			result.tableHitCount = 1;
+			return result;
+		}
+		
 		result.score = -SCORE_MAX;
+		bool pruned = false;
 		
 		for (const auto& ourAction: ourActions)
 		{
-			const GameState ourResult = state.apply(ourAction);
+			const GameState ourResult = applyMove(state, ourAction);
 			result.nodeCount++;
 			
 			// maximize(a, b) = -minimize(-b, -a).  This is why we don't need
 			// separate minimize() and maximize() functions.
-			MinimaxResult opponentResult = minimax(ourResult, evaluate, opponentOf(symbol), maximumDepth-1, -maximum, -result.score);
+			MinimaxResult opponentResult = minimax(ourResult, evaluate, opponentOf(symbol), maximumDepth-1, -maximum, -result.score, cancelled);
 			
 			result.score = std::max(result.score, -opponentResult.score);
 			result.cutOff |= opponentResult.cutOff;
@@ -88,21 +169,39 @@ MinimaxResult minimax(const GameState& state,
 			result.nodeCount += opponentResult.nodeCount;
 			result.prunedCount += opponentResult.opponentPrunedCount;
 			result.opponentPrunedCount += opponentResult.prunedCount;
+			result.tableHitCount += opponentResult.tableHitCount;
 			
 			if (result.score > maximum)
 			{
 				// We know that no matter what comes next, our parent won't pick
 				// this subtree.  So, we prune ourselves.
 				result.prunedCount++;
+				pruned = true;
 				break;
 			}
 		}
+		
+		// A cancelled search may have stopped anywhere, so its result is wrong.
+		if (key != 0 && !(cancelled && *cancelled))
+		{
+			entry.score = result.score;
+			entry.depth = maximumDepth;
+			entry.maximumDepth = result.maximumDepth;
+			entry.cutOff = result.cutOff;
+			entry.lowerBound = pruned;
+			table->store(key, entry);
+		}
 	}
 	
 	return result;
 }
 
-Action findBestAction(const GameState& state, Evaluator evaluate, const Symbol symbol, const unsigned int maximumDepth)
+Action findBestAction(const GameState& state,
+                      Evaluator evaluate,
+                      const Symbol symbol,
+                      const unsigned int maximumDepth,
+                      const std::atomic<bool>* const cancelled,
+                      std::ostream* const log)
 {
 	// The process here is basically the same thing as minimax() above.  One difference
 	// is that we don't do a beta cutoff check, since we know there is no parent that
@@ -110,13 +209,84 @@ Action findBestAction(const GameState& state, Evaluator evaluate, const Symbol s
 	// what.  However, we do still maintain an alpha value between our child minimax()
 	// calls.
 	
-	std::cout << "Thinking for player " << symbol << "..." << std::flush;
+	if (log) *log << "Thinking for player " << symbol << "..." << std::flush;
+	const ProfiledSearch profiledSearch;
+	
+	// Appends the profile to the statistics, if this search is being profiled.
+	// Stages that don't count their nodes pass 0.
+	const auto logProfile = [&](const unsigned int nodeCount)
+	{
+		if (!log || !profiledSearch.active()) return;
+		SearchProfile profile = profiledSearch.profile();
+		profile.nodeCount = nodeCount;
+		*log << ", " << profile;
+	};
 	
 	const auto actions = state.possibleActionsFor(symbol);
 	if (actions.empty())
 		throw std::runtime_error("findBestAction() called on terminal node.");
 	else
 	{
+		// Late in the game, the answer may already be built into the program.  The
+		// search would only see the whole game if it's deep enough, though, and if
+		// we're losing anyway, it's better at making the opponent work for the win.
+		if (actions.size() <= maximumDepth+1)
+		{
+			const PerfectPlayResult perfectResult = findPerfectAction(state, symbol);
+			if (perfectResult.found && perfectResult.outcome != Outcome::LOSS)
+			{
+				if (log)
+				{
+					*log << "selecting " << perfectResult.action << ".  "
+					     << "perfect-play table outcome: " << perfectResult.outcome;
+					logProfile(0);
+					*log << std::endl;
+				}
+				return perfectResult.action;
+			}
+		}
+		
+		// Forcing moves are cheap to search, so look for a forced win or a necessary
+		// block first.  Only as many plies as the full search would look at are
+		// considered, so that the easier difficulty levels don't get any smarter.
+		const ThreatSpaceResult threatResult = searchThreats(state, symbol, maximumDepth+1);
+		if (threatResult.kind != ThreatSpaceResult::Kind::NONE)
+		{
+			if (log)
+			{
+				*log << "selecting " << threatResult.proof.front() << ".  ";
+				if (threatResult.kind == ThreatSpaceResult::Kind::FORCED_WIN)
+				{
+					*log << "forced win:";
+					for (const auto& action: threatResult.proof) *log << " " << action;
+				}
+				else *log << "necessary block";
+				logProfile(0);
+				*log << std::endl;
+			}
+			return threatResult.proof.front();
+		}
+		
+		// Near the end of the game, we can afford to find the exact answer.  If
+		// we're losing anyway, though, minimax() is better at picking a move,
+		// since its heuristic at least makes the opponent work for the win.
+		if (actions.size() <= PROOF_NUMBER_EMPTY_THRESHOLD && maximumDepth >= PROOF_NUMBER_MINIMUM_DEPTH)
+		{
+			const ProofNumberResult exactResult = solveExactly(state, symbol, PROOF_NUMBER_NODE_LIMIT, cancelled);
+			if (exactResult.solved && exactResult.outcome != Outcome::LOSS)
+			{
+				if (log)
+				{
+					*log << "selecting " << exactResult.action << ".  "
+					     << "exact outcome: " << exactResult.outcome << ", "
+					     << "proof-number nodes: " << exactResult.nodeCount;
+					logProfile(exactResult.nodeCount);
+					*log << std::endl;
+				}
+				return exactResult.action;
+			}
+		}
+		
 		Action bestAction;
 		Score score = -SCORE_MAX - 1; // Ensure at least one action will be chosen.
 		bool cutOff = false;
@@ -124,17 +294,19 @@ Action findBestAction(const GameState& state, Evaluator evaluate, const Symbol s
 		unsigned int nodeCount = 1 + actions.size(); // The +1 is for the root node.
 		unsigned int prunedCount = 0;
 		unsigned int opponentPrunedCount = 0;
+		unsigned int tableHitCount = 0;
 		
 		for (const auto& candidateAction: actions)
 		{
-			const GameState candidateState = state.apply(candidateAction);
-			MinimaxResult candidateResult = minimax(candidateState, evaluate, opponentOf(symbol), maximumDepth, -SCORE_MAX, -score);
+			const GameState candidateState = applyMove(state, candidateAction);
+			MinimaxResult candidateResult = minimax(candidateState, evaluate, opponentOf(symbol), maximumDepth, -SCORE_MAX, -score, cancelled);
 			candidateResult.score *= -1;
 			cutOff |= candidateResult.cutOff;
 			maximumDepthReached = std::max(maximumDepth, candidateResult.maximumDepth+1);
 			nodeCount += candidateResult.nodeCount;
 			prunedCount += candidateResult.prunedCount;
 			opponentPrunedCount = candidateResult.opponentPrunedCount;
+			tableHitCount += candidateResult.tableHitCount;
 			if (candidateResult.score > score)
 			{
 				score = candidateResult.score;
@@ -142,12 +314,281 @@ Action findBestAction(const GameState& state, Evaluator evaluate, const Symbol s
 			}
 		}
 		
-		std::cout << "selecting " << bestAction << ".  "
-		          << "cut off: " << std::boolalpha << cutOff << ", "
-		          << "maximum depth: " << maximumDepthReached << ", "
-		          << "generated nodes: " << nodeCount << ", "
-		          << "pruned subtrees: " << prunedCount << ", "
-		          << "opponent's pruned subtrees: " << opponentPrunedCount << std::endl;
+		if (cancelled && *cancelled)
+		{
+			if (log) *log << "cancelled." << std::endl;
+			return bestAction;
+		}
+		
+		if (log)
+		{
+			*log << "selecting " << bestAction << ".  "
+			     << "cut off: " << std::boolalpha << cutOff << ", "
+			     << "maximum depth: " << maximumDepthReached << ", "
+			     << "generated nodes: " << nodeCount << ", "
+			     << "pruned subtrees: " << prunedCount << ", "
+			     << "opponent's pruned subtrees: " << opponentPrunedCount << ", "
+			     << "table hits: " << tableHitCount;
+			logProfile(nodeCount);
+			*log << std::endl;
+		}
 		return bestAction;
 	}
 }
+
+std::vector<AnalyzedMove> analyze(const GameState& state,
+                                  Evaluator evaluate,
+                                  const Symbol symbol,
+                                  const unsigned int maximumDepth,
+                                  const std::size_t moveCount,
+                                  const std::atomic<bool>* const cancelled)
+{
+	const auto actions = state.possibleActionsFor(symbol);
+	if (actions.empty())
+		throw std::runtime_error("analyze() called on terminal node.");
+	
+	// Kept sorted, best first, and never longer than moveCount.  Once it's full, a
+	// new move only gets in by beating the worst move on it, so each search only has
+	// to prove that.  Searching the opponent's reply with maximum = -threshold
+	// prunes it as soon as our score is known to be below threshold; otherwise, the
+	// score comes back exact.
+	std::vector<AnalyzedMove> moves;
+	for (const auto& action: actions)
+	{
+		if (moveCount == 0) break;
+		const Score threshold = moves.size() < moveCount ? -SCORE_MAX : moves.back().score + 1;
+		
+		const GameState actionState = applyMove(state, action);
+		const MinimaxResult opponentResult = minimax(actionState, evaluate, opponentOf(symbol), maximumDepth, -SCORE_MAX, -threshold, cancelled);
+		if (-opponentResult.score < threshold)
+			continue;
+		
+		AnalyzedMove move;
+		move.action = action;
+		move.score = -opponentResult.score;
+		move.result = opponentResult;
+		move.result.score = move.score;
+		move.result.maximumDepth = opponentResult.maximumDepth+1;
+		move.result.nodeCount = opponentResult.nodeCount+1;
+		move.result.prunedCount = opponentResult.opponentPrunedCount;
+		move.result.opponentPrunedCount = opponentResult.prunedCount;
+		
+		const auto position = std::upper_bound(moves.begin(), moves.end(), move, [](const AnalyzedMove& left, const AnalyzedMove& right)
+		{
+			return left.score > right.score;
+		});
+		moves.insert(position, move);
+		if (moves.size() > moveCount) moves.pop_back();
+	}
+	
+	// Each move of a principal variation is the first one that keeps the score it
+	// started with.  A reply searched with maximum = -score is pruned if the move
+	// does worse, and comes back exact otherwise, which can only mean it's equal.
+	// Those searches cover the same positions as the ones above, at the same depths,
+	// so the transposition table answers most of them.
+	for (auto& move: moves)
+	{
+		move.principalVariation.push_back(move.action);
+		GameState position = state.apply(move.action);
+		Symbol mover = opponentOf(symbol);
+		Score score = -move.score; // For mover.
+		for (unsigned int depth = maximumDepth; depth > 0 && !position.terminal(); depth--)
+		{
+			if (cancelled && *cancelled) break;
+			
+			bool found = false;
+			for (const auto& action: position.possibleActionsFor(mover))
+			{
+				const GameState next = position.apply(action);
+				const MinimaxResult reply = minimax(next, evaluate, opponentOf(mover), depth-1, -SCORE_MAX, -score, cancelled);
+				if (-reply.score >= score)
+				{
+					move.principalVariation.push_back(action);
+					position = next;
+					mover = opponentOf(mover);
+					score = reply.score;
+					found = true;
+					break;
+				}
+			}
+			if (!found) break; // Only if the search was cancelled.
+		}
+	}
+	
+	return moves;
+}
+
+ResumableSearch::ResumableSearch(const GameState& state,
+                                 Evaluator evaluate,
+                                 const Symbol symbol,
+                                 const unsigned int maximumDepth,
+                                 Score,
+                                 const Score maximum):
+	evaluate(evaluate)
+{
+	enter(state, symbol, maximumDepth, maximum);
+}
+
+ResumableSearch::ResumableSearch(const GameState& state,
+                                 Evaluator evaluate,
+                                 const Symbol symbol,
+                                 const unsigned int maximumDepth):
+	evaluate(evaluate), choosing(true)
+{
+	// findBestAction() searches each action as deep as minimax() would search the
+	// root, never prunes, and remembers nothing about the root, so the root frame
+	// is set up by hand.  Its score starts below anything possible, so that the
+	// first action gets picked even if every action loses.
+	Frame root;
+	root.state = state;
+	root.symbol = symbol;
+	root.maximumDepth = maximumDepth+1;
+	root.maximum = SCORE_MAX;
+	root.actions = state.possibleActionsFor(symbol);
+	root.result.score = -SCORE_MAX - 1;
+	if (root.actions.empty())
+		throw std::runtime_error("ResumableSearch set up to pick an action on a terminal node.");
+	rootStatistics.nodeCount = 1 + root.actions.size(); // The +1 is for the root node.
+	stack.push_back(std::move(root));
+}
+
+// Does what the start of minimax() does.  Nodes that come back right away are
+// finished on the spot; the others get a frame.
+void ResumableSearch::enter(const GameState& state, const Symbol symbol, const unsigned int maximumDepth, const Score maximum)
+{
+	MinimaxResult result;
+	auto ourActions = generateMoves(state, symbol);
+	
+	if (maximumDepth == 0 || checkTerminal(state) || ourActions.empty())
+	{
+		result.score = evaluateLeaf(evaluate, state, symbol);
+		result.cutOff = !ourActions.empty();
+		finish(result);
+		return;
+	}
+	
+	TranspositionTable* const table = transpositionTable;
+	const std::uint64_t key = table ? tableKey(state, evaluate, symbol) : 0;
+	TableEntry entry;
+	if (key != 0 && table->lookup(key, entry)
+	    && (entry.depth == maximumDepth || (!entry.cutOff && entry.depth <= maximumDepth))
+	    && (!entry.lowerBound || entry.score > maximum))
+	{
+		result.score = entry.score;
+		result.cutOff = entry.cutOff;
+		result.maximumDepth = entry.maximumDepth;
+		result.tableHitCount = 1;
+		finish(result);
+		return;
+	}
+	
+	Frame frame;
+	frame.state = state;
+	frame.symbol = symbol;
+	frame.maximumDepth = maximumDepth;
+	frame.maximum = maximum;
+	frame.actions = std::move(ourActions);
+	frame.key = key;
+	frame.result.score = -SCORE_MAX;
+	stack.push_back(std::move(frame));
+}
+
+// Hands a finished node's result to its parent, like returning from minimax()
+// does, and keeps going up for as long as that finishes the parent too.
+void ResumableSearch::finish(MinimaxResult result)
+{
+	while (!stack.empty())
+	{
+		Frame& parent = stack.back();
+		
+		// findBestAction() adds up its children's statistics in its own way.
+		if (choosing && stack.size() == 1)
+		{
+			rootStatistics.cutOff |= result.cutOff;
+			rootStatistics.maximumDepth = std::max(parent.maximumDepth-1, result.maximumDepth+1);
+			rootStatistics.nodeCount += result.nodeCount;
+			rootStatistics.prunedCount += result.prunedCount;
+			rootStatistics.opponentPrunedCount = result.opponentPrunedCount;
+			rootStatistics.tableHitCount += result.tableHitCount;
+		}
+		
+		const Score score = -result.score;
+		if (score > parent.result.score)
+		{
+			parent.result.score = score;
+			parent.bestAction = parent.actions[parent.nextAction-1];
+		}
+		parent.result.cutOff |= result.cutOff;
+		parent.result.maximumDepth = std::max(parent.result.maximumDepth, result.maximumDepth+1);
+		parent.result.nodeCount += result.nodeCount;
+		parent.result.prunedCount += result.opponentPrunedCount;
+		parent.result.opponentPrunedCount += result.prunedCount;
+		parent.result.tableHitCount += result.tableHitCount;
+		
+		bool pruned = false;
+		if (parent.result.score > parent.maximum)
+		{
+			parent.result.prunedCount++;
+			pruned = true;
+		}
+		else if (parent.nextAction < parent.actions.size())
+			return;
+		
+		if (parent.key != 0)
+		{
+			TableEntry entry;
+			entry.score = parent.result.score;
+			entry.depth = parent.maximumDepth;
+			entry.maximumDepth = parent.result.maximumDepth;
+			entry.cutOff = parent.result.cutOff;
+			entry.lowerBound = pruned;
+			transpositionTable.load()->store(parent.key, entry);
+		}
+		
+		result = parent.result;
+		finalAction = parent.bestAction;
+		stack.pop_back();
+	}
+	
+	finalResult = result;
+	if (choosing)
+	{
+		finalResult = rootStatistics;
+		finalResult.score = result.score;
+	}
+	finished = true;
+}
+
+bool ResumableSearch::step(unsigned int nodeBudget)
+{
+	while (!finished && nodeBudget > 0)
+	{
+		// The child's arguments have to be copied out, since entering it can move
+		// the stack around.
+		Frame& frame = stack.back();
+		const GameState child = applyMove(frame.state, frame.actions[frame.nextAction++]);
+		frame.result.nodeCount++;
+		nodeBudget--;
+		enter(child, opponentOf(frame.symbol), frame.maximumDepth-1, -frame.result.score);
+	}
+	return finished;
+}
+
+bool ResumableSearch::done() const
+{
+	return finished;
+}
+
+const MinimaxResult& ResumableSearch::result() const
+{
+	if (!finished)
+		throw std::runtime_error("ResumableSearch::result() called before the search was done.");
+	return finalResult;
+}
+
+Action ResumableSearch::bestAction() const
+{
+	if (!finished || !choosing)
+		throw std::runtime_error("ResumableSearch::bestAction() called on a search that doesn't pick one.");
+	return finalAction;
+}
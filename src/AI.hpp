@@ -2,6 +2,11 @@
 #define AI_HPP_INCLUDED
 
 #include "Game.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
 
 typedef int Score;
 constexpr Score SCORE_MAX = 1000; // SCORE_MIN is just -SCORE_MAX.  :)
@@ -34,17 +39,117 @@ struct MinimaxResult
 	
 	// The number of subtrees pruned by the minimizer.
 	unsigned int opponentPrunedCount = 0;
+	
+	// The number of subtrees whose results came from the transposition table.
+	unsigned int tableHitCount = 0;
 };
 
+class TranspositionTable;
+
+// Makes minimax() remember its results in table and reuse them whenever it meets
+// the same position again, in any thread.  A null table turns this off, which is
+// the default.  table must outlive every search that uses it.  Only the
+// evaluators above can be remembered; searches with any other evaluator don't
+// use the table.
+void useTranspositionTable(TranspositionTable* table);
+
 // Finds the value of the given node via the minimax algorithm with alpha-beta pruning.
 // state is the root node, evaluate is a heuristic function, symbol is the player that
 // the root node belongs to, maximumDepth is the number of tree layers below the root
 // node that are allowed to be generated, and minimum and maximum correspond to alpha
 // and beta.  The algorithm will not generate a subtree that it knows will fall outside
-// [minimum, maximum].
-MinimaxResult minimax(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth, Score minimum, Score maximum);
+// [minimum, maximum].  If cancelled is given and becomes true while the search is
+// running, the search winds down as fast as it can and its result is meaningless.
+MinimaxResult minimax(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth, Score minimum, Score maximum, const std::atomic<bool>* cancelled = nullptr);
+
+// Returns the best action for symbol to do, starting from state.  Search statistics
+// are written to log, unless it's null.  cancelled works like it does for minimax();
+// a cancelled search returns an arbitrary action.
+Action findBestAction(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth, const std::atomic<bool>* cancelled = nullptr, std::ostream* log = &std::cout);
 
-// Returns the best action for symbol to do, starting from state.
-Action findBestAction(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth);
+// One of the moves ranked by analyze().
+struct AnalyzedMove
+{
+	Action action;
+	
+	// The exact minimax() score of doing action, for the player doing it.
+	Score score = 0;
+	
+	// The moves both players would make from here on, as far as the search looked,
+	// starting with action.
+	std::vector<Action> principalVariation;
+	
+	// The statistics of the search that scored action, counted as part of the
+	// root's search like minimax() would count them.  Finding the principal
+	// variation afterwards isn't included.
+	MinimaxResult result;
+};
+
+// Ranks symbol's moves from state by their minimax() scores, best first, and
+// returns the best moveCount of them (or all of them, if there are fewer), with
+// exact scores and principal variations.  maximumDepth means what it does for
+// findBestAction(), whose minimax() search gives the best move the same score.
+// Moves that can't make the list are only searched until that's proven, and the
+// principal variations are mostly looked up in the transposition table, if one
+// is in use.  Equal scores keep the order of GameState::possibleActionsFor().
+// cancelled works like it does for minimax(); a cancelled analysis is meaningless.
+std::vector<AnalyzedMove> analyze(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth, std::size_t moveCount, const std::atomic<bool>* cancelled = nullptr);
+
+// A minimax() search that runs a little at a time on the calling thread, for when
+// there's no thread to spare.  Its stack is explicit, so it can stop after any node
+// and pick up from there later.  It gives the same result as minimax() with the
+// same arguments, statistics included, and remembers the same things in the
+// transposition table.
+class ResumableSearch
+{
+	public:
+		// Sets up minimax(state, evaluate, symbol, maximumDepth, minimum, maximum).
+		ResumableSearch(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth, Score minimum, Score maximum);
+		
+		// Sets up the minimax() search findBestAction() does to pick symbol's best
+		// action, which is what it falls back on when nothing it tries before that
+		// finds an answer.  result() then holds the score of the best action and the
+		// statistics findBestAction() writes to its log, counted the same way.
+		// Throws std::runtime_error if symbol has nothing to do.
+		ResumableSearch(const GameState& state, Evaluator evaluate, Symbol symbol, unsigned int maximumDepth);
+		
+		// Generates up to nodeBudget more nodes, and returns done().
+		bool step(unsigned int nodeBudget);
+		
+		bool done() const;
+		
+		// What minimax() would have returned.  Throws std::runtime_error unless done().
+		const MinimaxResult& result() const;
+		
+		// The action findBestAction()'s minimax() search would have picked.  Throws
+		// std::runtime_error unless done() and set up by the second constructor.
+		Action bestAction() const;
+	
+	private:
+		// One call of minimax() that's waiting for its children.
+		struct Frame
+		{
+			GameState state;
+			Symbol symbol;
+			unsigned int maximumDepth;
+			Score maximum;
+			std::vector<Action> actions;
+			std::size_t nextAction = 0;
+			std::uint64_t key = 0;
+			MinimaxResult result;
+			Action bestAction;
+		};
+		
+		void enter(const GameState& state, Symbol symbol, unsigned int maximumDepth, Score maximum);
+		void finish(MinimaxResult result);
+		
+		Evaluator* evaluate;
+		std::vector<Frame> stack;
+		MinimaxResult finalResult;
+		Action finalAction;
+		MinimaxResult rootStatistics; // Only for choosing.
+		bool choosing = false;
+		bool finished = false;
+};
 
 #endif
@@ -0,0 +1,182 @@
+#include "BoardFeed.hpp"
+#include "AI.hpp"
+
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+BoardFeed::BoardFeed(const std::size_t size): boards(size), changed(size, true), changedCount(size)
+{
+}
+
+std::size_t BoardFeed::size() const
+{
+	return boards.size();
+}
+
+void BoardFeed::publish(const std::size_t index, const GameState& gameState)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	boards[index] = gameState;
+	if (!changed[index])
+	{
+		changed[index] = true;
+		changedCount++;
+	}
+}
+
+void BoardFeed::touchAll()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	changed.assign(changed.size(), true);
+	changedCount = changed.size();
+}
+
+std::vector<std::size_t> BoardFeed::takeChanges(std::vector<GameState>& output, const std::size_t limit)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::size_t> indices;
+	for (std::size_t scanned = 0; scanned < boards.size() && changedCount > 0 && indices.size() < limit; scanned++)
+	{
+		if (changed[cursor])
+		{
+			output[cursor] = boards[cursor];
+			changed[cursor] = false;
+			changedCount--;
+			indices.push_back(cursor);
+		}
+		cursor = (cursor+1) % boards.size();
+	}
+	return indices;
+}
+
+std::size_t BoardFeed::pendingCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return changedCount;
+}
+
+namespace
+{
+	// Depths to pick from for each player.  Kept shallow so that hundreds of
+	// games can move along at a watchable pace.
+	const unsigned int SELF_PLAY_DEPTHS[] = {0, 1, 2, 4};
+	
+	// The first few moves of every game are random, so that games between AIs
+	// with the same depth don't all play out identically.
+	constexpr unsigned int RANDOM_OPENING_MOVES = 2;
+	
+	// How long a finished game stays on the board before a new one starts.
+	constexpr auto GAME_OVER_PAUSE = std::chrono::seconds(2);
+	
+	struct SelfPlayGame
+	{
+		GameState gameState;
+		Symbol turn = Symbol::X;
+		unsigned int depths[2] = {0, 0}; // For X and O, respectively.
+		unsigned int moveCount = 0;
+		std::chrono::steady_clock::time_point nextUpdate;
+	};
+}
+
+SelfPlayRunner::SelfPlayRunner(BoardFeed& feed, const unsigned int threadCount): feed(feed), stopping(false)
+{
+	for (unsigned int worker = 0; worker < threadCount; worker++)
+		threads.emplace_back(&SelfPlayRunner::work, this, worker, threadCount);
+}
+
+SelfPlayRunner::~SelfPlayRunner()
+{
+	stopping = true;
+	for (auto& thread: threads)
+		thread.join();
+}
+
+void SelfPlayRunner::work(const unsigned int worker, const unsigned int workerCount)
+{
+	std::mt19937 random(std::random_device{}() + worker);
+	std::uniform_int_distribution<std::size_t> depthIndex(0, sizeof(SELF_PLAY_DEPTHS)/sizeof(*SELF_PLAY_DEPTHS)-1);
+	
+	// This worker owns every workerCount'th board.
+	std::vector<std::size_t> places;
+	std::vector<SelfPlayGame> games;
+	for (std::size_t place = worker; place < feed.size(); place += workerCount)
+	{
+		places.push_back(place);
+		games.emplace_back();
+	}
+	
+	while (!stopping)
+	{
+		auto nextUpdate = std::chrono::steady_clock::now() + std::chrono::milliseconds(SELF_PLAY_MOVE_INTERVAL_MS);
+		for (std::size_t index = 0; index < games.size() && !stopping; index++)
+		{
+			SelfPlayGame& game = games[index];
+			const auto now = std::chrono::steady_clock::now();
+			if (now < game.nextUpdate)
+			{
+				nextUpdate = std::min(nextUpdate, game.nextUpdate);
+				continue;
+			}
+			
+			if (game.moveCount == 0 || game.gameState.terminal())
+			{
+				game = SelfPlayGame();
+				game.depths[0] = SELF_PLAY_DEPTHS[depthIndex(random)];
+				game.depths[1] = SELF_PLAY_DEPTHS[depthIndex(random)];
+			}
+			
+			Action action;
+			if (game.moveCount < RANDOM_OPENING_MOVES)
+			{
+				const auto actions = game.gameState.possibleActionsFor(game.turn);
+				action = actions[std::uniform_int_distribution<std::size_t>(0, actions.size()-1)(random)];
+			}
+			else
+			{
+				const unsigned int depth = game.depths[game.turn == Symbol::X ? 0 : 1];
+				action = findBestAction(game.gameState, improvedEvaluator, game.turn, depth, &stopping, nullptr);
+			}
+			if (stopping) break;
+			
+			game.gameState = game.gameState.apply(action);
+			game.turn = opponentOf(game.turn);
+			game.moveCount++;
+			game.nextUpdate = std::chrono::steady_clock::now() + std::chrono::milliseconds(SELF_PLAY_MOVE_INTERVAL_MS);
+			if (game.gameState.terminal()) game.nextUpdate += GAME_OVER_PAUSE;
+			feed.publish(places[index], game.gameState);
+			nextUpdate = std::min(nextUpdate, game.nextUpdate);
+		}
+		
+		// Sleep in short steps, so that stopping doesn't have to wait long.
+		while (!stopping && std::chrono::steady_clock::now() < nextUpdate)
+			std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(nextUpdate - std::chrono::steady_clock::now(), std::chrono::milliseconds(20)));
+	}
+}
+
+void startReadingBoardRecords(std::istream& input, std::shared_ptr<BoardFeed> feed)
+{
+	// The thread can't be interrupted while it's blocked reading, so it's detached
+	// and shares ownership of the feed instead of being joined.
+	std::thread([&input, feed]()
+	{
+		std::string line;
+		while (std::getline(input, line))
+		{
+			std::istringstream record(line);
+			std::size_t index;
+			std::string spaces;
+			if (!(record >> index >> spaces) || index >= feed->size() || spaces.size() != 16)
+				continue;
+			
+			GameState gameState;
+			for (std::size_t place = 0; place < spaces.size(); place++)
+			{
+				if (spaces[place] == 'X') gameState.symbols[place] = Symbol::X;
+				else if (spaces[place] == 'O') gameState.symbols[place] = Symbol::O;
+			}
+			feed->publish(index, gameState);
+		}
+	}).detach();
+}
@@ -0,0 +1,76 @@
+#ifndef BOARD_FEED_HPP_INCLUDED
+#define BOARD_FEED_HPP_INCLUDED
+
+#include "Game.hpp"
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <iostream>
+
+// A fixed number of boards that producers update from their own threads and
+// the dashboard reads from the GUI thread.  Only boards that changed since the
+// last read are handed out, so the reader can skip the rest.
+class BoardFeed
+{
+	public:
+		explicit BoardFeed(std::size_t size);
+		
+		std::size_t size() const;
+		
+		// Replaces the board at index.
+		void publish(std::size_t index, const GameState& gameState);
+		
+		// Marks every board as changed, e.g. so they all get redrawn.
+		void touchAll();
+		
+		// Copies up to limit changed boards into boards (which must hold size()
+		// elements) and returns their indices.  The search for changed boards picks
+		// up where the last call left off, so a small limit still gets to every
+		// board eventually.
+		std::vector<std::size_t> takeChanges(std::vector<GameState>& boards, std::size_t limit);
+		
+		// Returns the number of changed boards that haven't been taken yet.
+		std::size_t pendingCount() const;
+	
+	private:
+		mutable std::mutex mutex;
+		std::vector<GameState> boards;
+		std::vector<bool> changed;
+		std::size_t changedCount = 0;
+		std::size_t cursor = 0;
+};
+
+// Plays AI-versus-AI games on every board of a feed, in the background, with
+// randomly chosen difficulty levels and openings.  Each board gets a move every
+// SELF_PLAY_MOVE_INTERVAL_MS milliseconds or so, depending on how long the AI
+// takes to think.
+class SelfPlayRunner
+{
+	public:
+		SelfPlayRunner(BoardFeed& feed, unsigned int threadCount);
+		
+		// Stops every game and waits for the threads to finish.
+		~SelfPlayRunner();
+	
+	private:
+		void work(unsigned int worker, unsigned int workerCount);
+		
+		BoardFeed& feed;
+		std::atomic<bool> stopping;
+		std::vector<std::thread> threads;
+};
+
+constexpr unsigned int SELF_PLAY_MOVE_INTERVAL_MS = 200;
+
+// Starts a detached thread that reads board records from input until it ends,
+// publishing them to feed.  Each record is a line holding a board index and
+// 16 characters for the spaces, left-to-right and top-to-bottom, where X and O
+// are symbols and anything else is an empty space.  For example:
+//     3 XO..X..O........
+// Malformed lines and out-of-range indices are skipped.
+void startReadingBoardRecords(std::istream& input, std::shared_ptr<BoardFeed> feed);
+
+#endif
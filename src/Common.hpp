@@ -1,6 +0,0 @@
-#ifndef COMMON_HPP_INCLUDED
-#define COMMON_HPP_INCLUDED
-
-constexpr float PI = 3.1415926535897932;
-
-#endif
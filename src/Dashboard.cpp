@@ -0,0 +1,231 @@
+#include "Dashboard.hpp"
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// Never redraw fewer boards than this per frame, however slow things get.
+	constexpr std::size_t MINIMUM_REDRAW_LIMIT = 16;
+	
+	// An offscreen color buffer the size of the window.  Boards stay drawn on it
+	// between frames.
+	struct Canvas
+	{
+		GLuint framebuffer = 0;
+		GLuint texture = 0;
+		int width = 0;
+		int height = 0;
+	};
+	
+	Canvas createCanvas(SDL_Window* const window)
+	{
+		Canvas canvas;
+		SDL_GL_GetDrawableSize(window, &canvas.width, &canvas.height);
+		
+		glGenTextures(1, &canvas.texture);
+		glBindTexture(GL_TEXTURE_2D, canvas.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, canvas.width, canvas.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		
+		glGenFramebuffers(1, &canvas.framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, canvas.framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, canvas.texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			throw std::runtime_error("Error creating the dashboard's framebuffer.");
+		
+		glViewport(0, 0, canvas.width, canvas.height);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return canvas;
+	}
+	
+	void destroyCanvas(Canvas& canvas)
+	{
+		glDeleteFramebuffers(1, &canvas.framebuffer);
+		glDeleteTextures(1, &canvas.texture);
+		canvas = Canvas();
+	}
+	
+	// Copies the canvas to the window.
+	void present(SDL_Window* const window, const Canvas& canvas)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas.framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, canvas.width, canvas.height, 0, 0, canvas.width, canvas.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		SDL_GL_SwapWindow(window);
+	}
+	
+	// Boards are laid out left-to-right, top-to-bottom in a roughly square grid of cells.
+	struct Layout
+	{
+		unsigned int columns;
+		unsigned int rows;
+		
+		explicit Layout(const std::size_t boardCount)
+		{
+			columns = std::max(1u, (unsigned int)std::ceil(std::sqrt((double)boardCount)));
+			rows = std::max(1u, (unsigned int)((boardCount + columns - 1) / columns));
+		}
+		
+		Vector cellSize() const
+		{
+			return {2.0f/columns, 2.0f/rows};
+		}
+		
+		Vector cellCenter(const std::size_t index) const
+		{
+			const Vector size = cellSize();
+			return {-1 + size.x*(index%columns + 0.5f), 1 - size.y*(index/columns + 0.5f)};
+		}
+		
+		// The scale that makes a board fill a cell.
+		float boardScale() const
+		{
+			const Vector size = cellSize();
+			return std::min(size.x, size.y)/2;
+		}
+	};
+	
+	Color gridColorFor(const GameState& gameState)
+	{
+		const Symbol winner = gameState.winner();
+		if (winner == Symbol::X) return GREEN;
+		else if (winner == Symbol::O) return RED;
+		else if (gameState.terminal()) return YELLOW;
+		else return WHITE;
+	}
+	
+	// Collects statistics over a second at a time and shows them in the window title.
+	class DashboardCounter
+	{
+		public:
+			void countSkipped()
+			{
+				skippedFrames++;
+			}
+			
+			void countDrawn(const FrameStatistics& frame, const std::size_t boardsRedrawn)
+			{
+				drawnFrames++;
+				redrawnBoards += boardsRedrawn;
+				drawCalls += frame.drawCalls;
+				cpuMilliseconds += frame.cpuMilliseconds;
+				if (frame.cpuMilliseconds > DASHBOARD_FRAME_BUDGET_MS) overBudgetFrames++;
+			}
+			
+			void show(SDL_Window* const window, const std::size_t boardCount, const std::size_t pendingCount)
+			{
+				const auto now = std::chrono::steady_clock::now();
+				if (now - periodBegin < std::chrono::seconds(1)) return;
+				
+				const unsigned int divisor = std::max(1u, drawnFrames);
+				std::ostringstream title;
+				title.precision(3);
+				title << "Tic-Tac-Toe dashboard (" << boardCount << " boards, "
+				      << drawnFrames << " frames drawn, " << skippedFrames << " skipped, "
+				      << overBudgetFrames << " over budget, "
+				      << redrawnBoards << " boards redrawn, " << pendingCount << " waiting, "
+				      << drawCalls/divisor << " draw calls and "
+				      << cpuMilliseconds/divisor << " ms CPU per frame)";
+				SDL_SetWindowTitle(window, title.str().c_str());
+				*this = DashboardCounter();
+				periodBegin = now;
+			}
+		
+		private:
+			std::chrono::steady_clock::time_point periodBegin = std::chrono::steady_clock::now();
+			unsigned int drawnFrames = 0;
+			unsigned int skippedFrames = 0;
+			unsigned int overBudgetFrames = 0;
+			std::size_t redrawnBoards = 0;
+			unsigned int drawCalls = 0;
+			double cpuMilliseconds = 0;
+	};
+}
+
+void runDashboard(SDL_Window* const window, Renderer& renderer, BoardFeed& feed)
+{
+	const Layout layout(feed.size());
+	const Vector cellSize = layout.cellSize();
+	const float scale = layout.boardScale();
+	const auto framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(DASHBOARD_FRAME_BUDGET_MS));
+	
+	Canvas canvas = createCanvas(window);
+	std::vector<GameState> boards(feed.size());
+	std::size_t redrawLimit = feed.size();
+	DashboardCounter counter;
+	feed.touchAll();
+	
+	auto nextFrame = std::chrono::steady_clock::now();
+	bool done = false;
+	while (!done)
+	{
+		bool exposed = false;
+		SDL_Event event;
+		while (SDL_PollEvent(&event))
+		{
+			switch (event.type)
+			{
+				case SDL_WINDOWEVENT:
+					switch (event.window.event)
+					{
+						case SDL_WINDOWEVENT_SIZE_CHANGED:
+							destroyCanvas(canvas);
+							canvas = createCanvas(window);
+							feed.touchAll();
+							break;
+						case SDL_WINDOWEVENT_EXPOSED:
+							exposed = true;
+							break;
+					}
+					break;
+				case SDL_QUIT:
+					done = true;
+					break;
+			}
+		}
+		
+		const auto changes = feed.takeChanges(boards, redrawLimit);
+		if (changes.empty())
+		{
+			counter.countSkipped();
+			if (exposed) present(window, canvas);
+		}
+		else
+		{
+			beginFrame(renderer);
+			for (const std::size_t index: changes)
+			{
+				// Paint over whatever was in the cell before.
+				const Vector center = layout.cellCenter(index);
+				drawRectangle(renderer, DARK_GRAY, center - cellSize/2, center + cellSize/2);
+				drawGame(renderer, boards[index], gridColorFor(boards[index]), center, scale);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, canvas.framebuffer);
+			endFrame(renderer);
+			present(window, canvas);
+			counter.countDrawn(renderer.frame, changes.size());
+			
+			// Degrade gracefully by putting off some boards until later frames.
+			if (renderer.frame.cpuMilliseconds > DASHBOARD_FRAME_BUDGET_MS)
+				redrawLimit = std::max(redrawLimit/2, MINIMUM_REDRAW_LIMIT);
+			else if (renderer.frame.cpuMilliseconds < DASHBOARD_FRAME_BUDGET_MS/2)
+				redrawLimit = std::min(redrawLimit + redrawLimit/4 + 1, feed.size());
+		}
+		counter.show(window, feed.size(), feed.pendingCount());
+		
+		nextFrame += framePeriod;
+		const auto now = std::chrono::steady_clock::now();
+		if (nextFrame < now) nextFrame = now; // Don't try to catch up on missed frames.
+		else std::this_thread::sleep_until(nextFrame);
+	}
+	
+	destroyCanvas(canvas);
+}
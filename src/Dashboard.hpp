@@ -0,0 +1,20 @@
+#ifndef DASHBOARD_HPP_INCLUDED
+#define DASHBOARD_HPP_INCLUDED
+
+#include <SDL.h>
+#include "Graphics.hpp"
+#include "BoardFeed.hpp"
+
+// The dashboard aims for 60 frames per second, and this is how much CPU time
+// each frame gets.  When frames go over budget, fewer boards are redrawn per
+// frame, and the rest wait for later frames.
+constexpr double DASHBOARD_FRAME_BUDGET_MS = 1000.0/60;
+
+// Shows every board in feed, laid out in a grid, until the window is closed.
+// Boards are drawn into an offscreen framebuffer that persists between frames,
+// so only boards that changed get redrawn, and frames where nothing changed are
+// skipped altogether.  The window needs to be single-sampled, so that the
+// framebuffer can be blitted to it.
+void runDashboard(SDL_Window* window, Renderer& renderer, BoardFeed& feed);
+
+#endif
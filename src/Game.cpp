@@ -1,6 +1,8 @@
 #include "Game.hpp"
 
 #include <algorithm>
+#include <stdexcept>
+#include <string>
 
 std::ostream& operator<<(std::ostream& output, const Symbol symbol)
 {
@@ -28,6 +30,26 @@ std::ostream& operator<<(std::ostream& output, const Action action)
 	return output;
 }
 
+std::ostream& operator<<(std::ostream& output, const Outcome outcome)
+{
+	switch (outcome)
+	{
+		case Outcome::LOSS:
+			output << "loss";
+			break;
+		case Outcome::DRAW:
+			output << "draw";
+			break;
+		case Outcome::WIN:
+			output << "win";
+			break;
+		default:
+			output << '!';
+			break;
+	}
+	return output;
+}
+
 // If one symbol makes up the entirety of line, returns that symbol.  Else,
 // returns Symbol::EMPTY.
 static Symbol lineWinner(const std::array<Symbol, 4> line)
@@ -87,14 +109,9 @@ std::array<std::array<Symbol, 4>, 2> GameState::diagonals() const
 std::array<std::array<Symbol, 4>, 10> GameState::lines() const
 {
 	std::array<std::array<Symbol, 4>, 10> lines;
-	std::array<std::array<Symbol, 4>, 4> rows = this->rows();
-	std::array<std::array<Symbol, 4>, 4> columns = this->columns();
-	std::array<std::array<Symbol, 4>, 2> diagonals = this->diagonals();
-	
-	auto begin = lines.begin();
-	begin = std::copy(rows.begin(), rows.end(), begin);
-	begin = std::copy(columns.begin(), columns.end(), begin);
-	begin = std::copy(diagonals.begin(), diagonals.end(), begin);
+	for (std::size_t line = 0; line < lines.size(); line++)
+		for (std::size_t index = 0; index < 4; index++)
+			lines[line][index] = symbols[LINE_PLACES[line][index]];
 	return lines;
 }
 
@@ -113,6 +130,14 @@ bool GameState::terminal() const
 	return winner() != Symbol::EMPTY || std::count(symbols.begin(), symbols.end(), Symbol::EMPTY) == 0;
 }
 
+Outcome GameState::outcomeFor(const Symbol symbol) const
+{
+	const Symbol winner = this->winner();
+	if (winner == symbol) return Outcome::WIN;
+	else if (winner == opponentOf(symbol)) return Outcome::LOSS;
+	else return Outcome::DRAW;
+}
+
 Symbol opponentOf(Symbol symbol)
 {
 	switch (symbol)
@@ -125,3 +150,35 @@ Symbol opponentOf(Symbol symbol)
 			return Symbol::EMPTY;
 	}
 }
+
+std::vector<std::uint64_t> lineMasksFor(const unsigned int size)
+{
+	if (size == 0 || size > MAXIMUM_BOARD_SIZE)
+		throw std::runtime_error("Boards can't be " + std::to_string(size) + " spaces wide.");
+	
+	std::vector<std::uint64_t> lines;
+	std::uint64_t diagonal1 = 0, diagonal2 = 0;
+	for (unsigned int first = 0; first < size; first++)
+	{
+		std::uint64_t row = 0, column = 0;
+		for (unsigned int second = 0; second < size; second++)
+		{
+			row |= std::uint64_t(1) << (first*size + second);
+			column |= std::uint64_t(1) << (second*size + first);
+		}
+		lines.push_back(row);
+		lines.push_back(column);
+		diagonal1 |= std::uint64_t(1) << (first*size + first);
+		diagonal2 |= std::uint64_t(1) << (first*size + size-1-first);
+	}
+	lines.push_back(diagonal1);
+	lines.push_back(diagonal2);
+	return lines;
+}
+
+bool coversLine(const std::uint64_t spaces, const std::vector<std::uint64_t>& lines)
+{
+	for (const std::uint64_t line: lines)
+		if ((spaces & line) == line) return true;
+	return false;
+}
@@ -2,6 +2,7 @@
 #define GAME_HPP_INCLUDED
 
 #include <cstddef>
+#include <cstdint>
 #include <array>
 #include <vector>
 #include <iostream>
@@ -23,6 +24,24 @@ struct Action
 
 std::ostream& operator<<(std::ostream& ostream, const Action action);
 
+// How a game ends, from one player's point of view.
+enum class Outcome
+{
+	LOSS,
+	DRAW,
+	WIN
+};
+
+std::ostream& operator<<(std::ostream& output, const Outcome outcome);
+
+// The places making up each row, column and diagonal, in the order
+// GameState::lines() returns them.
+constexpr std::array<std::array<std::size_t, 4>, 10> LINE_PLACES = {{
+	{{0, 1, 2, 3}}, {{4, 5, 6, 7}}, {{8, 9, 10, 11}}, {{12, 13, 14, 15}},
+	{{0, 4, 8, 12}}, {{1, 5, 9, 13}}, {{2, 6, 10, 14}}, {{3, 7, 11, 15}},
+	{{0, 5, 10, 15}}, {{3, 6, 9, 12}}
+}};
+
 struct GameState
 {
 	// A left-to-right, top-to-bottom list of tiles.
@@ -43,7 +62,7 @@ struct GameState
 	// Returns the 2 diagonal lines.
 	std::array<std::array<Symbol, 4>, 2> diagonals() const;
 	
-	// Returns all rows, columns and diagonals.
+	// Returns all rows, columns and diagonals, as laid out by LINE_PLACES.
 	std::array<std::array<Symbol, 4>, 10> lines() const;
 	
 	// Returns the symbol that won the game, or EMPTY if neither has won (yet).
@@ -52,9 +71,23 @@ struct GameState
 	
 	// Returns true if there is a winner, or if there are no spaces left.
 	bool terminal() const;
+	
+	// Returns how the game ended for symbol.  Only meaningful for terminal states.
+	Outcome outcomeFor(Symbol symbol) const;
 };
 
 // Returns O for X, X for O and EMPTY for EMPTY.
 Symbol opponentOf(Symbol);
 
+// The same rules on a size-by-size board, for solvers that go beyond 4x4.  Spaces
+// are numbered the same way as in GameState, and a set of spaces is a mask with
+// one bit per space.
+constexpr unsigned int MAXIMUM_BOARD_SIZE = 8;
+
+// Returns a mask for each row, column and diagonal of a size-by-size board.
+std::vector<std::uint64_t> lineMasksFor(unsigned int size);
+
+// Returns true if spaces covers any of lines.
+bool coversLine(std::uint64_t spaces, const std::vector<std::uint64_t>& lines);
+
 #endif
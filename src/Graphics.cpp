@@ -2,11 +2,111 @@
 
 #include <stdexcept>
 #include <vector>
-#include <cmath>
-#include "Common.hpp"
-#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 
-constexpr unsigned int CURVE_SEGMENTS = 64;
+namespace
+{
+	constexpr std::uint32_t SHADER_CACHE_MAGIC = 0x50535454; // "TTSP"
+	constexpr std::uint32_t SHADER_CACHE_VERSION = 1;
+	
+	// The start of a shader cache file, followed by size bytes of program binary.
+	struct ShaderCacheHeader
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t binaryFormat;
+		std::uint32_t size;
+	};
+	
+	std::string glString(const GLenum name)
+	{
+		const GLubyte* const string = glGetString(name);
+		return string ? reinterpret_cast<const char*>(string) : "";
+	}
+	
+	// Identifies the sources a cached program was built from and the driver that
+	// built it, with a 64-bit FNV-1a hash.  Drivers are supposed to reject binaries
+	// they can't use anyway, but not all of them are careful about it.
+	std::uint64_t shaderCacheKey(const std::string& vertexSource, const std::string& fragmentSource)
+	{
+		std::uint64_t hash = 0xcbf29ce484222325;
+		for (const std::string& string: {vertexSource, fragmentSource, glString(GL_VENDOR), glString(GL_RENDERER), glString(GL_VERSION)})
+		{
+			// Hash the terminating null too, so strings can't run into each other.
+			for (std::size_t index = 0; index <= string.size(); index++)
+				hash = (hash ^ (unsigned char)string.c_str()[index])*0x100000001b3;
+		}
+		return hash;
+	}
+	
+	// Returns 0 if there's no cached program at path that the driver will take.
+	GLuint loadProgramBinary(const std::string& path, const std::uint64_t key)
+	{
+		std::ifstream file(path, std::ios::binary);
+		ShaderCacheHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		    header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION || header.key != key)
+			return 0;
+		
+		// A damaged size shouldn't make us allocate much, so it has to match what's
+		// actually left in the file.
+		const std::streamoff binaryBegin = file.tellg();
+		if (!file.seekg(0, std::ios::end) || file.tellg() - binaryBegin != std::streamoff(header.size) || !file.seekg(binaryBegin))
+			return 0;
+		
+		std::vector<char> binary(header.size);
+		if (!file.read(binary.data(), binary.size()))
+			return 0;
+		
+		const GLuint program = glCreateProgram();
+		glProgramBinary(program, header.binaryFormat, binary.data(), binary.size());
+		
+		GLint success;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glDeleteProgram(program);
+			glGetError(); // A format the driver doesn't know raises an error we don't care about.
+			return 0;
+		}
+		return program;
+	}
+	
+	// Failing to save the cache only costs the next launch some time, so errors are
+	// ignored.  The file is written under another name first and then renamed, so
+	// another instance never loads half of it.
+	void saveProgramBinary(const GLuint program, const std::string& path, const std::uint64_t key)
+	{
+		GLint size = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+		if (size <= 0) return;
+		
+		std::vector<char> binary(size);
+		GLsizei length = 0;
+		GLenum binaryFormat = 0;
+		glGetProgramBinary(program, size, &length, &binaryFormat, binary.data());
+		if (length <= 0) return;
+		
+		const ShaderCacheHeader header = {SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, key, binaryFormat, std::uint32_t(length)};
+		const std::string temporaryPath = path + ".new";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary|std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(binary.data(), length);
+			if (!file)
+			{
+				file.close();
+				std::remove(temporaryPath.c_str());
+				return;
+			}
+		}
+		std::rename(temporaryPath.c_str(), path.c_str());
+	}
+}
 
 GLuint compileShader(const GLenum type, const std::string& source)
 {	
@@ -21,11 +121,69 @@ GLuint compileShader(const GLenum type, const std::string& source)
 	{
 		GLchar infoLog[512];
 		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		glDeleteShader(shader);
 		throw std::runtime_error(std::string("Error compiling shader: ") + infoLog);
 	}
 	return shader;
 }
 
+GLuint linkShaderProgram(const std::string& vertexSource,
+                         const std::string& fragmentSource,
+                         const std::string& cachePath,
+                         bool& fromCache)
+{
+	const bool caching = !cachePath.empty() && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+	const std::uint64_t key = caching ? shaderCacheKey(vertexSource, fragmentSource) : 0;
+	
+	fromCache = false;
+	if (caching)
+	{
+		const GLuint program = loadProgramBinary(cachePath, key);
+		if (program)
+		{
+			fromCache = true;
+			return program;
+		}
+	}
+	
+	const GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader;
+	try
+	{
+		fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	}
+	catch (...)
+	{
+		glDeleteShader(vertexShader);
+		throw;
+	}
+	
+	const GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	if (caching) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	
+	// The linked program doesn't need the shader objects any more.
+	glDetachShader(program, vertexShader);
+	glDetachShader(program, fragmentShader);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		GLchar infoLog[512];
+		glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+		glDeleteProgram(program);
+		throw std::runtime_error(std::string("Error linking shader program: ") + infoLog);
+	}
+	
+	if (caching) saveProgramBinary(program, cachePath, key);
+	return program;
+}
+
 bool Vector::in(Vector cornerA, Vector cornerB)
 {
 	return x > std::min(cornerA.x, cornerB.x) &&
@@ -34,12 +192,6 @@ bool Vector::in(Vector cornerA, Vector cornerB)
 	       y < std::max(cornerA.y, cornerB.y);
 }
 
-
-Vector Vector::fromPolar(float angle, float radius)
-{
-	return {std::cos(angle)*radius, std::sin(angle)*radius};
-}
-
 Vector operator+(const Vector left, const Vector right)
 {
 	return {left.x+right.x, left.y+right.y};
@@ -67,169 +219,176 @@ Vector operator/(const Vector vector, const float scalar)
 
 namespace
 {
-	void draw(const ShaderProgram& shader, const Color color, const GLenum mode, const std::vector<Vector>& vertices)
+	constexpr float STROKE_WIDTH = 0.05;
+	constexpr float SYMBOL_SIZE = (1.0/8)*0.8;
+}
+
+Renderer createRenderer(const ShaderProgram& shader)
+{
+	Renderer renderer;
+	renderer.shader = shader;
+	
+	glGenVertexArrays(1, &renderer.vertexArray);
+	glBindVertexArray(renderer.vertexArray);
+	
+	// The shader stretches this over each shape's bounding box.
+	const GLfloat corners[] = {0, 0, 1, 0, 1, 1, 1, 1, 0, 1, 0, 0};
+	glGenBuffers(1, &renderer.quadBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(VERTEX_SHADER_POSITION_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
+	glEnableVertexAttribArray(VERTEX_SHADER_POSITION_LOCATION);
+	
+	glGenBuffers(1, &renderer.instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, renderer.instanceBuffer);
+	glVertexAttribIPointer(VERTEX_SHADER_INSTANCE_KIND_LOCATION, 1, GL_INT, sizeof(Instance), (GLvoid*)offsetof(Instance, kind));
+	glVertexAttribPointer(VERTEX_SHADER_INSTANCE_ENDPOINTS_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)offsetof(Instance, from));
+	glVertexAttribPointer(VERTEX_SHADER_INSTANCE_SIZE_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)offsetof(Instance, size));
+	glVertexAttribPointer(VERTEX_SHADER_INSTANCE_COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)offsetof(Instance, color));
+	for (const GLuint location: {VERTEX_SHADER_INSTANCE_KIND_LOCATION, VERTEX_SHADER_INSTANCE_ENDPOINTS_LOCATION, VERTEX_SHADER_INSTANCE_SIZE_LOCATION, VERTEX_SHADER_INSTANCE_COLOR_LOCATION})
 	{
-		GLuint vao;
-		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
-		
-		GLuint vbo;
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		
-		std::vector<GLfloat> flattenedVertices;
-		flattenedVertices.reserve(vertices.size()*2);
-		for (const Vector& vertex: vertices)
-		{
-			flattenedVertices.push_back(vertex.x);
-			flattenedVertices.push_back(vertex.y);
-		}
-		
-		glBufferData(GL_ARRAY_BUFFER, flattenedVertices.size()*sizeof(GLfloat), flattenedVertices.data(), GL_STATIC_DRAW);
-		
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-		glEnableVertexAttribArray(0);
-		
-		glUniform3f(shader.colorUniformLocation, color.red, color.green, color.blue);
-		
-		glDrawArrays(mode, 0, vertices.size());
-		
-		glDeleteBuffers(1, &vbo);
-		glDeleteVertexArrays(1, &vao);
+		glEnableVertexAttribArray(location);
+		glVertexAttribDivisor(location, 1);
 	}
+	
+	glBindVertexArray(0);
+	return renderer;
+}
+
+void destroyRenderer(Renderer& renderer)
+{
+	glDeleteBuffers(1, &renderer.instanceBuffer);
+	glDeleteBuffers(1, &renderer.quadBuffer);
+	glDeleteVertexArrays(1, &renderer.vertexArray);
 }
 
-void drawPie(const ShaderProgram& shader,
-             const Color color,
-             const Vector position,
-             const float radius,
-             float begin,
-             float length)
+void beginFrame(Renderer& renderer)
 {
-	const float step = length/CURVE_SEGMENTS;
-	std::vector<Vector> vertices = {position};
-	for (unsigned int triangle = 0; triangle < CURVE_SEGMENTS; triangle++)
+	renderer.frame = FrameStatistics();
+	renderer.frame.begin = std::chrono::steady_clock::now();
+	renderer.instances.clear();
+}
+
+void endFrame(Renderer& renderer)
+{
+	if (!renderer.instances.empty())
 	{
-		const float angle1 = begin + step*triangle;
-		const float angle2 = begin + step*(triangle+1);
-		vertices.push_back(position + Vector{std::cos(angle1), std::sin(angle1)} * radius);
-		vertices.push_back(position + Vector{std::cos(angle2), std::sin(angle2)} * radius);
+		glBindBuffer(GL_ARRAY_BUFFER, renderer.instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, renderer.instances.size()*sizeof(Instance), renderer.instances.data(), GL_STREAM_DRAW);
+		
+		// The shader needs to know how big a pixel is to antialias edges.
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glUseProgram(renderer.shader.id);
+		glUniform2f(renderer.shader.pixelSizeUniformLocation, 2.0f/viewport[2], 2.0f/viewport[3]);
+		glBindVertexArray(renderer.vertexArray);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, renderer.instances.size());
+		glBindVertexArray(0);
+		renderer.frame.drawCalls++;
 	}
-	draw(shader, color, GL_TRIANGLE_FAN, vertices);
+	
+	const auto duration = std::chrono::steady_clock::now() - renderer.frame.begin;
+	renderer.frame.cpuMilliseconds = std::chrono::duration<double, std::milli>(duration).count();
 }
 
-void drawLine(const ShaderProgram& shader,
+void drawCapsule(Renderer& renderer,
+                 const Color color,
+                 const Vector from,
+                 const Vector to,
+                 const float width)
+{
+	renderer.instances.push_back({SHAPE_CAPSULE, from, to, {width/2, 0}, color});
+}
+
+void drawRing(Renderer& renderer,
               const Color color,
-              const Vector from,
-              const Vector to,
+              const Vector position,
+              const float radius,
               const float width)
 {
-	const float angle = std::atan2((to-from).y, (to-from).x);
-	const Vector offset = Vector{std::cos(angle+PI/2), std::sin(angle+PI/2)}*width/2;
-	const Vector corners[] = {to+offset, from+offset, from-offset, to-offset};
-	const std::vector<Vector> vertices = {
-		corners[0], corners[1], corners[2],
-		corners[2], corners[3], corners[0]
-	};
-	draw(shader, color, GL_TRIANGLES, vertices);
-}
-
-void drawCappedLine(const ShaderProgram& shader,
-                    const Color color,
-                    const Vector from,
-                    const Vector to,
-                    const float width)
-{
-	drawLine(shader, color, from, to, width);
-	const float angle1 = std::atan2((to-from).y, (to-from).x) + PI/2;
-	const float angle2 = angle1+PI;
-	drawPie(shader, color, from, width/2, angle1, PI);
-	drawPie(shader, color, to, width/2, angle2, PI);
-}
-
-void drawArc(const ShaderProgram& shader,
-             Color color,
-             Vector position,
-             float radius,
-             float begin,
-             float length,
-             float width)
-{
-	std::vector<Vector> vertices;
-	vertices.reserve((CURVE_SEGMENTS+1)*2);
-	vertices.push_back(position+Vector::fromPolar(begin, radius-width/2));
-	vertices.push_back(position+Vector::fromPolar(begin, radius+width/2));
-	for (unsigned int segment = 0; segment <= CURVE_SEGMENTS; segment++)
-	{
-		const float angle = begin + (length/CURVE_SEGMENTS)*segment;
-		vertices.push_back(position+ Vector::fromPolar(angle, radius-width/2));
-		vertices.push_back(position+ Vector::fromPolar(angle, radius+width/2));
-	}
-	draw(shader, color, GL_TRIANGLE_STRIP, vertices);
+	renderer.instances.push_back({SHAPE_RING, position, position, {radius, width}, color});
 }
 
-void drawRectangle(const ShaderProgram& shader,
-                   Color color,
-                   Vector cornerA,
-                   Vector cornerB)
+void drawCircle(Renderer& renderer,
+                const Color color,
+                const Vector position,
+                const float radius)
 {
-	std::vector<Vector> vertices = {
-		cornerA, {cornerB.x, cornerA.y}, cornerB,
-		cornerB, {cornerA.x, cornerB.y}, cornerA
-	};
-	draw(shader, color, GL_TRIANGLES, vertices);
+	renderer.instances.push_back({SHAPE_CAPSULE, position, position, {radius, 0}, color});
+}
+
+void drawRectangle(Renderer& renderer,
+                   const Color color,
+                   const Vector cornerA,
+                   const Vector cornerB)
+{
+	renderer.instances.push_back({SHAPE_BOX, cornerA, cornerB, {0, 0}, color});
 }
 
-void drawX(const ShaderProgram& shader,
-           Color color,
-           Vector position)
+void drawX(Renderer& renderer,
+           const Color color,
+           const Vector position,
+           const float scale)
 {
-	const Vector offset1 = Vector{1, 1}/8*0.8;
+	const Vector offset1 = Vector{SYMBOL_SIZE, SYMBOL_SIZE}*scale;
 	const Vector offset2 = {offset1.x, -offset1.y};
-	drawCappedLine(shader, color, position+offset1, position-offset1, 0.05);
-	drawCappedLine(shader, color, position+offset2, position-offset2, 0.05);
+	drawCapsule(renderer, color, position+offset1, position-offset1, STROKE_WIDTH*scale);
+	drawCapsule(renderer, color, position+offset2, position-offset2, STROKE_WIDTH*scale);
 }
 
-void drawO(const ShaderProgram& shader,
-           Color color,
-           Vector position)
+void drawO(Renderer& renderer,
+           const Color color,
+           const Vector position,
+           const float scale)
 {
-	drawArc(shader, color, position, (1.0/8)*0.8, 0, PI*2, 0.05);
+	drawRing(renderer, color, position, SYMBOL_SIZE*scale, STROKE_WIDTH*scale);
 }
 
-void drawSymbol(const ShaderProgram& shader,
-                Color color,
-                Symbol symbol,
-                Vector position)
+void drawSymbol(Renderer& renderer,
+                const Color color,
+                const Symbol symbol,
+                const Vector position,
+                const float scale)
 {
-	if (symbol == Symbol::X) drawX(shader, color, position);
-	else if (symbol == Symbol::O) drawO(shader, color, position);
+	if (symbol == Symbol::X) drawX(renderer, color, position, scale);
+	else if (symbol == Symbol::O) drawO(renderer, color, position, scale);
 }
 
-void drawGrid(const ShaderProgram& shader,
-              Color color)
+void drawGrid(Renderer& renderer,
+              const Color color,
+              const Vector position,
+              const float scale)
 {
-	const float INNER_SIZE = 0.9;
-	const float width = 0.05;
-	
-	drawCappedLine(shader, color, {-INNER_SIZE, -INNER_SIZE/2}, {INNER_SIZE, -INNER_SIZE/2}, width);
-	drawCappedLine(shader, color, {-INNER_SIZE, 0}, {INNER_SIZE, 0}, width);
-	drawCappedLine(shader, color, {-INNER_SIZE, INNER_SIZE/2}, {INNER_SIZE, INNER_SIZE/2}, width);
-	
-	drawCappedLine(shader, color, {-INNER_SIZE/2, -INNER_SIZE}, {-INNER_SIZE/2, INNER_SIZE}, width);
-	drawCappedLine(shader, color, {0, -INNER_SIZE}, {0, INNER_SIZE}, width);
-	drawCappedLine(shader, color, {INNER_SIZE/2, -INNER_SIZE}, {INNER_SIZE/2, INNER_SIZE}, width);
+	const float extent = INNER_SIZE*scale;
+	for (const float place: {-INNER_SIZE/2, 0.0f, INNER_SIZE/2})
+	{
+		drawCapsule(renderer, color, position + Vector{-extent, place*scale}, position + Vector{extent, place*scale}, STROKE_WIDTH*scale);
+		drawCapsule(renderer, color, position + Vector{place*scale, -extent}, position + Vector{place*scale, extent}, STROKE_WIDTH*scale);
+	}
+}
+
+void drawDivider(Renderer& renderer,
+                 const Color color)
+{
+	drawCapsule(renderer, color, {0, -0.5}, {0, 0.5}, STROKE_WIDTH);
 }
 
-void drawGame(ShaderProgram& shaderProgram, const GameState& gameState, const Color gridColor)
+void drawGame(Renderer& renderer,
+              const GameState& gameState,
+              const Color gridColor,
+              const Vector position,
+              const float scale)
 {
-	drawGrid(shaderProgram, gridColor);
+	drawGrid(renderer, gridColor, position, scale);
 	for (unsigned int row = 0; row < 4; row++)
 	{
 		for (unsigned int column = 0; column < 4; column++)
 		{
 			const unsigned int place = row*4+column;
-			drawSymbol(shaderProgram, WHITE, gameState.symbols[place], spaceCenter(row, column));
+			drawSymbol(renderer, WHITE, gameState.symbols[place], position + spaceCenter(row, column)*scale, scale);
 		}
 	}
 }
@@ -2,6 +2,8 @@
 #define GRAPHICS_HPP_INCLUDED
 
 #include <string>
+#include <vector>
+#include <chrono>
 #include "GLEW.hpp"
 #include "Shader.hpp"
 #include "Game.hpp"
@@ -27,7 +29,6 @@ struct Vector
 {
 	float x;
 	float y;
-	static Vector fromPolar(float angle, float radius);
 	bool in(Vector cornerA, Vector cornerB);
 };
 Vector operator+(Vector, Vector);
@@ -38,55 +39,117 @@ Vector operator/(Vector, float);
 
 GLuint compileShader(GLenum type, const std::string& source);
 
-void drawPie(const ShaderProgram& shader,
-             Color color,
-             Vector position,
-             float radius,
-             float begin,
-             float length);
+// Compiles and links a shader program, and returns its ID.  If cachePath isn't
+// empty and the driver supports program binaries, the linked program is saved
+// there, and later calls load it from there instead of compiling it again.  A
+// cached program built from other sources or by another driver, or one the
+// driver rejects, is rebuilt from source.  fromCache says which way it went.
+// Throws std::runtime_error if the sources don't compile or link.
+GLuint linkShaderProgram(const std::string& vertexSource,
+                         const std::string& fragmentSource,
+                         const std::string& cachePath,
+                         bool& fromCache);
+
+// One shape, as described by the per-instance vertex attributes.  See
+// Shader.hpp for how each kind of shape uses from, to and size.
+struct Instance
+{
+	GLint kind;  // SHAPE_CAPSULE, SHAPE_RING or SHAPE_BOX.
+	Vector from; // The start of a capsule, the center of a ring or a corner of a box.
+	Vector to;   // The end of a capsule, the center of a ring or the opposite corner of a box.
+	Vector size; // The radius of a capsule, or the radius and stroke width of a ring.
+	Color color;
+};
+
+// Counts the work done for one frame.  See beginFrame() and endFrame().
+struct FrameStatistics
+{
+	unsigned int drawCalls = 0;
+	
+	// CPU time spent between beginFrame() and endFrame(), not counting the time
+	// spent waiting for the buffer swap.
+	double cpuMilliseconds = 0;
+	
+	std::chrono::steady_clock::time_point begin;
+};
+
+// Everything we need to draw the GUI.  Every shape is an instance of a single
+// quad, so the whole frame is one instanced draw call, and shapes are drawn in
+// the order they're queued up.
+struct Renderer
+{
+	ShaderProgram shader;
+	GLuint vertexArray = 0;
+	GLuint quadBuffer = 0;
+	GLuint instanceBuffer = 0; // Refilled every frame.
+	std::vector<Instance> instances;
+	FrameStatistics frame;
+};
 
-void drawLine(const ShaderProgram& shader,
+// Needs a current OpenGL context.
+Renderer createRenderer(const ShaderProgram& shader);
+void destroyRenderer(Renderer& renderer);
+
+// The draw*() functions below only queue shapes up.  endFrame() actually draws them.
+void beginFrame(Renderer& renderer);
+void endFrame(Renderer& renderer);
+
+// Draws a line with rounded ends.
+void drawCapsule(Renderer& renderer,
+                 Color color,
+                 Vector from,
+                 Vector to,
+                 float width);
+
+void drawRing(Renderer& renderer,
               Color color,
-              Vector from,
-              Vector to,
+              Vector position,
+              float radius,
               float width);
 
-void drawCappedLine(const ShaderProgram& shader,
-                    Color color,
-                    Vector from,
-                    Vector to,
-                    float width);
-
-void drawArc(const ShaderProgram& shader,
-             Color color,
-             Vector position,
-             float radius,
-             float begin,
-             float length,
-             float width);
-
-void drawRectangle(const ShaderProgram& shader,
+void drawCircle(Renderer& renderer,
+                Color color,
+                Vector position,
+                float radius);
+
+void drawRectangle(Renderer& renderer,
                    Color color,
                    Vector cornerA,
                    Vector cornerB);
 
-void drawX(const ShaderProgram& shader,
+// Symbols are sized to fit one board space, times scale.
+void drawX(Renderer& renderer,
            Color color,
-           Vector position);
+           Vector position,
+           float scale = 1);
 
-void drawO(const ShaderProgram& shader,
+void drawO(Renderer& renderer,
            Color color,
-           Vector position);
+           Vector position,
+           float scale = 1);
 
-void drawSymbol(const ShaderProgram& shader,
+void drawSymbol(Renderer& renderer,
                 Color color,
                 Symbol symbol,
-                Vector position);
-
-void drawGrid(const ShaderProgram& shader,
-              Color color);
+                Vector position,
+                float scale = 1);
 
-void drawGame(ShaderProgram& shaderProgram, const GameState& gameState, const Color gridColor);
+// Draws the board's lines, shrunk by scale and centered on position.
+void drawGrid(Renderer& renderer,
+              Color color,
+              Vector position = {0, 0},
+              float scale = 1);
+
+// Draws the vertical line splitting the symbol selection screen.
+void drawDivider(Renderer& renderer,
+                 Color color);
+
+// Draws a whole board, shrunk by scale and centered on position.
+void drawGame(Renderer& renderer,
+              const GameState& gameState,
+              Color gridColor,
+              Vector position = {0, 0},
+              float scale = 1);
 
 // Returns the normalized device coordinates of the center of the space
 // indexed by row and column.
@@ -5,12 +5,24 @@
 #include "Graphics.hpp"
 #include "Game.hpp"
 #include "AI.hpp"
-#include "Common.hpp"
+#include "BoardFeed.hpp"
+#include "Dashboard.hpp"
+#include "TranspositionTable.hpp"
+#include "Retrograde.hpp"
+#include "PerfectPlay.hpp"
+#include "Profiling.hpp"
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <sstream>
 #include <future>
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <algorithm>
 
 namespace
 {
@@ -21,7 +33,7 @@ namespace
 		SDL_GL_GetDrawableSize(window, &viewportWidth, &viewportHeight);
 		glViewport(0, 0, viewportWidth, viewportHeight);
 	}
-
+	
 	// Returns the mouse position in normalized device coordinates.
 	Vector getMousePosition(SDL_Window* const window)
 	{
@@ -31,7 +43,140 @@ namespace
 		SDL_GL_GetDrawableSize(window, &width, &height);
 		return {(float)x/width*2-1, (float)y/height*-2+1};
 	}
-
+	
+	struct Options
+	{
+		// If this isn't 0, we show a dashboard with this many boards instead of
+		// letting the user play a game.
+		std::size_t dashboardBoards = 0;
+		
+		// Whether the dashboard's boards come from records on standard input,
+		// instead of from self-play.  See startReadingBoardRecords().
+		bool dashboardRecords = false;
+		
+		// If this isn't empty, the AI's transposition table is the shared one with
+		// this name, instead of a private one.  See TranspositionTable.
+		std::string sharedTable;
+		
+		// If this isn't empty, we just print the statistics of the shared
+		// transposition table with this name and exit.
+		std::string inspectedTable;
+		
+		// If solving.size isn't 0, we run the retrograde solver instead of the game.
+		RetrogradeOptions solving;
+		
+		// If this is set, we just check the built-in perfect-play table and exit.
+		bool verifyingPerfectPlay = false;
+		
+		// Whether to add hardware performance counts to the AI's statistics.
+		bool profiling = false;
+		
+		// If this isn't empty, we just print the AI's analysis of this board, in the
+		// format of a board record, and exit.  See startReadingBoardRecords().
+		std::string analyzedBoard;
+		
+		// How many of the best moves the analysis shows.
+		std::size_t analysisLines = 3;
+		
+		// Whether the AI thinks on the GUI thread, a slice at a time between frames,
+		// instead of in threads of its own.  See ResumableSearch.
+		bool singleThreaded = false;
+	};
+	
+	// Usage: main [--dashboard BOARDS [--records]] [--shared-table NAME] [--profile]
+	//        main [--single-threaded] [--shared-table NAME]
+	//        main --inspect-table NAME
+	//        main --solve SIZE DIRECTORY [--memory MEGABYTES] [--threads THREADS]
+	//        main --verify-perfect-play
+	//        main --analyze BOARD [--lines LINES] [--shared-table NAME]
+	Options parseOptions(const int argc, char* argv[])
+	{
+		Options options;
+		options.solving.size = 0;
+		options.solving.threadCount = std::max(1u, std::thread::hardware_concurrency());
+		bool linesGiven = false;
+		bool solverOptionsGiven = false;
+		for (int index = 1; index < argc; index++)
+		{
+			const std::string argument = argv[index];
+			if (argument == "--dashboard" && index+1 < argc)
+			{
+				options.dashboardBoards = std::stoul(argv[++index]);
+				if (options.dashboardBoards == 0)
+					throw std::runtime_error("The dashboard needs at least one board.");
+			}
+			else if (argument == "--records")
+				options.dashboardRecords = true;
+			else if (argument == "--shared-table" && index+1 < argc)
+				options.sharedTable = argv[++index];
+			else if (argument == "--inspect-table" && index+1 < argc)
+				options.inspectedTable = argv[++index];
+			else if (argument == "--solve" && index+2 < argc)
+			{
+				options.solving.size = std::stoul(argv[++index]);
+				options.solving.directory = argv[++index];
+				if (options.solving.size == 0)
+					throw std::runtime_error("Boards need at least one space.");
+			}
+			else if (argument == "--memory" && index+1 < argc)
+			{
+				options.solving.memoryBudget = std::stoull(argv[++index]) << 20;
+				solverOptionsGiven = true;
+			}
+			else if (argument == "--threads" && index+1 < argc)
+			{
+				options.solving.threadCount = std::stoul(argv[++index]);
+				solverOptionsGiven = true;
+			}
+			else if (argument == "--verify-perfect-play")
+				options.verifyingPerfectPlay = true;
+			else if (argument == "--profile")
+				options.profiling = true;
+			else if (argument == "--single-threaded")
+				options.singleThreaded = true;
+			else if (argument == "--analyze" && index+1 < argc)
+				options.analyzedBoard = argv[++index];
+			else if (argument == "--lines" && index+1 < argc)
+			{
+				options.analysisLines = std::stoul(argv[++index]);
+				linesGiven = true;
+				if (options.analysisLines == 0)
+					throw std::runtime_error("The analysis needs at least one line.");
+			}
+			else
+				throw std::runtime_error("Unrecognized argument: " + argument);
+		}
+		if (options.dashboardRecords && options.dashboardBoards == 0)
+			throw std::runtime_error("--records only makes sense with --dashboard.");
+		if (linesGiven && options.analyzedBoard.empty())
+			throw std::runtime_error("--lines only makes sense with --analyze.");
+		if (solverOptionsGiven && options.solving.size == 0)
+			throw std::runtime_error("--memory and --threads only make sense with --solve.");
+		if (options.singleThreaded && options.dashboardBoards)
+			throw std::runtime_error("The dashboard needs threads for its games, so it can't be single-threaded.");
+		return options;
+	}
+	
+	// Sets up the dashboard's boards and runs it until its window is closed.
+	void showDashboard(SDL_Window* const window, Renderer& renderer, const Options& options)
+	{
+		const auto feed = std::make_shared<BoardFeed>(options.dashboardBoards);
+		if (options.dashboardRecords)
+		{
+			startReadingBoardRecords(std::cin, feed);
+			runDashboard(window, renderer, *feed);
+		}
+		else
+		{
+			// Leave a core for the GUI, and don't bother with more threads than boards.
+			// hardware_concurrency() is 0 if it can't tell.
+			const unsigned int coreCount = std::max(1u, std::thread::hardware_concurrency());
+			const unsigned int threadCount = std::max<std::size_t>(1, std::min<std::size_t>(coreCount-1, feed->size()));
+			SelfPlayRunner runner(*feed, threadCount);
+			runDashboard(window, renderer, *feed);
+		}
+	}
+	
 	enum class State
 	{
 		DIFFICULTY_SELECTION,
@@ -41,17 +186,297 @@ namespace
 		GAMEPLAY_AI_TURN_WAITING,
 		GAME_OVER
 	};
+	
+	// Collects frame statistics over a second at a time and shows them in the
+	// window title.  A frame is skipped when the main loop wakes up but nothing
+	// on the screen needs to change.
+	class FrameCounter
+	{
+		public:
+			void countRendered(const FrameStatistics& frame)
+			{
+				renderedFrames++;
+				drawCalls += frame.drawCalls;
+				cpuMilliseconds += frame.cpuMilliseconds;
+			}
+			
+			void countSkipped()
+			{
+				skippedFrames++;
+			}
+			
+			void show(SDL_Window* const window)
+			{
+				const auto now = std::chrono::steady_clock::now();
+				if (now - periodBegin < std::chrono::seconds(1)) return;
+				
+				const unsigned int divisor = std::max(1u, renderedFrames);
+				std::ostringstream title;
+				title.precision(3);
+				title << "Tic-Tac-Toe (" << renderedFrames << " frames rendered, "
+				      << skippedFrames << " skipped, "
+				      << drawCalls/divisor << " draw calls and "
+				      << cpuMilliseconds/divisor << " ms CPU per frame)";
+				SDL_SetWindowTitle(window, title.str().c_str());
+				*this = FrameCounter();
+				periodBegin = now;
+			}
+		
+		private:
+			std::chrono::steady_clock::time_point periodBegin = std::chrono::steady_clock::now();
+			unsigned int renderedFrames = 0;
+			unsigned int skippedFrames = 0;
+			unsigned int drawCalls = 0;
+			double cpuMilliseconds = 0;
+	};
+	
+	// The longest the main loop sleeps without any events, so that the frame
+	// statistics in the title still get updated.
+	constexpr int IDLE_TIMEOUT_MS = 1000;
+	
+	// The SDL event type posted whenever an AI search finishes.
+	Uint32 aiFinishedEventType = (Uint32)-1;
+	
+	// Buttons on the difficulty selection screen, easiest first.
+	const std::pair<Vector, Vector> DIFFICULTY_BUTTONS[] = {
+		{{-0.5, 0.125}, {0.5, 0.375}},
+		{{-0.5, -0.125}, {0.5, 0.125}},
+		{{-0.5, -0.375}, {0.5, -0.125}}
+	};
+	
+	// Buttons on the symbol selection screen.
+	const std::pair<Vector, Vector> X_BUTTON = {{-0.75, -0.25}, {-0.25, 0.25}};
+	const std::pair<Vector, Vector> O_BUTTON = {{0.75, 0.25}, {0.25, -0.25}};
+	
+	// Returns the place of the board space under the mouse.
+	unsigned int placeUnder(const Vector mouse)
+	{
+		unsigned int row = (unsigned int)((-mouse.y/INNER_SIZE+1)*2);
+		unsigned int column = (unsigned int)((mouse.x/INNER_SIZE+1)*2);
+		if (row > 3) row = 3;
+		if (column > 3) column = 3;
+		return row*4+column;
+	}
+	
+	// The AI's search depth for each difficulty level.
+	const unsigned int MAXIMUM_DEPTHS[] = {0, 1, 6};
+	const unsigned int HARDEST_DIFFICULTY = sizeof(MAXIMUM_DEPTHS)/sizeof(*MAXIMUM_DEPTHS) - 1;
+	
+	// An AI search running in another thread.  It buffers its statistics so that
+	// they only get printed if somebody actually uses the result.
+	struct BackgroundSearch
+	{
+		std::unique_ptr<std::atomic<bool>> cancelled;
+		std::unique_ptr<std::ostringstream> log;
+		
+		// Ready as soon as the search is done, before the main loop gets woken up.
+		std::future<Action> decision;
+		
+		// The search's thread.  Destroying this waits for the thread to finish, so
+		// it has to go before what the thread uses.
+		std::future<void> thread;
+	};
+	
+	BackgroundSearch startSearch(const GameState& gameState, const Symbol symbol, const unsigned int maximumDepth)
+	{
+		BackgroundSearch search;
+		search.cancelled.reset(new std::atomic<bool>(false));
+		search.log.reset(new std::ostringstream);
+		
+		const std::atomic<bool>* const cancelled = search.cancelled.get();
+		std::ostream* const log = search.log.get();
+		const auto decision = std::make_shared<std::promise<Action>>();
+		search.decision = decision->get_future();
+		search.thread = std::async(std::launch::async, [=]()
+		{
+			try
+			{
+				decision->set_value(findBestAction(gameState, improvedEvaluator, symbol, maximumDepth, cancelled, log));
+			}
+			catch (...)
+			{
+				decision->set_exception(std::current_exception());
+			}
+			
+			// Wake up the main loop, which can see the decision by now.
+			SDL_Event event = {};
+			event.type = aiFinishedEventType;
+			SDL_PushEvent(&event);
+		});
+		return search;
+	}
+	
+	// Blocks until the search is done, prints its statistics and returns its decision.
+	Action finishSearch(BackgroundSearch& search)
+	{
+		const Action action = search.decision.get();
+		std::cout << search.log->str();
+		return action;
+	}
+	
+	// In single-threaded mode, the AI gets this many nodes at a time...
+	constexpr unsigned int SEARCH_STEP_NODES = 1024;
+	
+	// ...until it's had this much time for the frame.  A step usually takes well
+	// under a millisecond, so the GUI stays responsive while the AI thinks.
+	constexpr double SEARCH_SLICE_MS = 8;
+	
+	// Prints a stepped search's decision and statistics, like findBestAction() does.
+	Action finishSteppedSearch(const ResumableSearch& search, const Symbol symbol)
+	{
+		const Action action = search.bestAction();
+		const MinimaxResult& result = search.result();
+		std::cout << "Thinking for player " << symbol << "..."
+		          << "selecting " << action << ".  "
+		          << "cut off: " << std::boolalpha << result.cutOff << ", "
+		          << "maximum depth: " << result.maximumDepth << ", "
+		          << "generated nodes: " << result.nodeCount << ", "
+		          << "pruned subtrees: " << result.prunedCount << ", "
+		          << "opponent's pruned subtrees: " << result.opponentPrunedCount << ", "
+		          << "table hits: " << result.tableHitCount << std::endl;
+		return action;
+	}
+	
+	// Asks the search to stop, if it's running, then waits for its thread to wind down.
+	void cancelSearch(BackgroundSearch& search)
+	{
+		if (!search.decision.valid()) return;
+		*search.cancelled = true;
+		search.thread.wait(); // Before cancelled goes away.
+		search = BackgroundSearch();
+	}
+	
+	// Asks every search to stop, then waits for all of their threads to wind down.
+	void cancelSearches(std::map<std::size_t, BackgroundSearch>& searches)
+	{
+		for (auto& search: searches)
+			*search.second.cancelled = true;
+		searches.clear(); // Destroying a std::async future joins its thread.
+	}
+	
+	double millisecondsBetween(const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+	
+	// Prints the best moves from board, a board record's spaces, for whoever's
+	// turn it is, as the hardest difficulty level sees them.
+	void printAnalysis(const std::string& board, const std::size_t lineCount)
+	{
+		if (board.size() != 16)
+			throw std::runtime_error("A board needs 16 spaces: " + board);
+		
+		GameState gameState;
+		for (std::size_t place = 0; place < board.size(); place++)
+		{
+			if (board[place] == 'X') gameState.symbols[place] = Symbol::X;
+			else if (board[place] == 'O') gameState.symbols[place] = Symbol::O;
+		}
+		
+		const auto xCount = std::count(gameState.symbols.begin(), gameState.symbols.end(), Symbol::X);
+		const auto oCount = std::count(gameState.symbols.begin(), gameState.symbols.end(), Symbol::O);
+		if (xCount != oCount && xCount != oCount+1)
+			throw std::runtime_error("X goes first, so this board can't happen: " + board);
+		if (gameState.terminal())
+			throw std::runtime_error("This game is already over: " + board);
+		
+		const Symbol symbol = xCount == oCount ? Symbol::X : Symbol::O;
+		const unsigned int maximumDepth = MAXIMUM_DEPTHS[HARDEST_DIFFICULTY];
+		std::cout << "Best moves for player " << symbol << " at depth " << maximumDepth << ":" << std::endl;
+		
+		const auto moves = analyze(gameState, improvedEvaluator, symbol, maximumDepth, lineCount);
+		for (std::size_t rank = 0; rank < moves.size(); rank++)
+		{
+			const AnalyzedMove& move = moves[rank];
+			std::cout << rank+1 << ". " << move.action << ".  "
+			          << "score: " << move.score << ", "
+			          << "cut off: " << std::boolalpha << move.result.cutOff << ", "
+			          << "generated nodes: " << move.result.nodeCount << ", "
+			          << "table hits: " << move.result.tableHitCount << ", "
+			          << "line:";
+			for (const auto& action: move.principalVariation)
+				std::cout << " " << action;
+			std::cout << std::endl;
+		}
+	}
+	
+	// Keeps speculative searches going for the AI's reply to every move the player
+	// could make from gameState, keyed by the place the player would take.  Only one
+	// search per core runs at a time, and the rest start as those finish, so this
+	// needs calling again whenever a search finishes.  There are at most 16 moves, so
+	// we don't bother guessing which ones are likely.  Searches of depth 1 or less
+	// take no time anyway, so they aren't worth starting early.
+	void ponder(std::map<std::size_t, BackgroundSearch>& ponderings, const GameState& gameState, const Symbol playerSymbol, const unsigned int maximumDepth)
+	{
+		if (maximumDepth <= 1) return;
+		
+		// hardware_concurrency() is 0 if it can't tell.
+		const std::size_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+		std::size_t runningCount = 0;
+		for (const auto& pondering: ponderings)
+		{
+			if (pondering.second.decision.wait_for(std::chrono::milliseconds(0)) != std::future_status::ready)
+				runningCount++;
+		}
+		
+		for (const auto& playerAction: gameState.possibleActionsFor(playerSymbol))
+		{
+			if (runningCount >= coreCount) break;
+			if (ponderings.count(playerAction.place) != 0) continue;
+			
+			const GameState reply = gameState.apply(playerAction);
+			if (!reply.terminal())
+			{
+				ponderings[playerAction.place] = startSearch(reply, opponentOf(playerSymbol), maximumDepth);
+				runningCount++;
+			}
+		}
+	}
 }
 
-int main()
+int main(int argc, char* argv[])
 {	
+	// For the time-to-first-frame statistics.
+	const auto launchTime = std::chrono::steady_clock::now();
+	
+	const Options options = parseOptions(argc, argv);
+	
+	if (options.verifyingPerfectPlay)
+		return verifyPerfectPlayTable(std::cout) == 0 ? 0 : 1;
+	
+	if (options.solving.size)
+	{
+		solveRetrograde(options.solving);
+		return 0;
+	}
+	
+	if (!options.inspectedTable.empty())
+	{
+		const TranspositionTable table(options.inspectedTable, 0);
+		std::cout << table.statistics();
+		return 0;
+	}
+	
+	setSearchProfiling(options.profiling);
+	
+	// Every AI search shares this, so it has to outlive all of them.
+	const std::unique_ptr<TranspositionTable> transpositionTable(options.sharedTable.empty()
+		? new TranspositionTable()
+		: new TranspositionTable(options.sharedTable, DEFAULT_TABLE_ENTRY_COUNT));
+	useTranspositionTable(transpositionTable.get());
+	
+	if (!options.analyzedBoard.empty())
+	{
+		printAnalysis(options.analyzedBoard, options.analysisLines);
+		return 0;
+	}
+	
+	const auto windowBegin = std::chrono::steady_clock::now();
 	if (SDL_Init(SDL_INIT_VIDEO))
 		throw std::runtime_error(std::string("Error initializing SDL: ") + SDL_GetError());
 	
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
 	
 	SDL_Window* window = SDL_CreateWindow("Tic-Tac-Toe",
 	                                      SDL_WINDOWPOS_CENTERED,
@@ -71,36 +496,71 @@ int main()
 	if (glewInit() != GLEW_OK)
 		throw std::runtime_error("Error initializing GLEW.");
 	
-	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER_SOURCE);
-	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER_SOURCE);
+	const auto windowEnd = std::chrono::steady_clock::now();
+	
+	// Compiling the shaders is a noticeable part of startup, so the linked program
+	// is cached in the user's preferences directory.  Without one, we just don't cache.
+	char* const preferencesPath = SDL_GetPrefPath("tic-tac-toe", "tic-tac-toe");
+	const std::string shaderCachePath = preferencesPath ? std::string(preferencesPath) + "shader-program.bin" : "";
+	SDL_free(preferencesPath);
 	
 	ShaderProgram shaderProgram;
-	shaderProgram.id = glCreateProgram();
-	glAttachShader(shaderProgram.id, vertexShader);
-	glAttachShader(shaderProgram.id, fragmentShader);
-	glLinkProgram(shaderProgram.id);
+	bool shaderProgramCached;
+	shaderProgram.id = linkShaderProgram(VERTEX_SHADER_SOURCE, FRAGMENT_SHADER_SOURCE, shaderCachePath, shaderProgramCached);
 	glUseProgram(shaderProgram.id);
+	const auto shaderEnd = std::chrono::steady_clock::now();
 	shaderProgram.vertexAttributeLocation = 0;
-	shaderProgram.colorUniformLocation = glGetUniformLocation(shaderProgram.id, "inColor");
-		
+	shaderProgram.pixelSizeUniformLocation = glGetUniformLocation(shaderProgram.id, "pixelSize");
+	
+	Renderer renderer = createRenderer(shaderProgram);
+	FrameCounter frameCounter;
+	
 	glClearColor(DARK_GRAY.red, DARK_GRAY.green, DARK_GRAY.blue, 1.0f);	
 	setViewport(window);
 	
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe.
 	
+	aiFinishedEventType = SDL_RegisterEvents(1);
+	
+	if (options.dashboardBoards)
+	{
+		showDashboard(window, renderer, options);
+		destroyRenderer(renderer);
+		return 0;
+	}
+	
 	auto state = State::DIFFICULTY_SELECTION;
 	unsigned int difficultyLevel = 0;
 	Symbol playerSymbol = Symbol::EMPTY;
 	GameState gameState;
 	
-	std::future<Action> aiDecision;
-		
+	BackgroundSearch aiSearch;
+	
+	// The AI's search in single-threaded mode, which the main loop steps through
+	// between frames.  Single-threaded mode doesn't ponder or warm anything up.
+	std::unique_ptr<ResumableSearch> steppedSearch;
+	
+	// While the player chooses a difficulty and a symbol, the AI works out its
+	// opening move at HARDEST_DIFFICULTY, which fills the transposition table for
+	// whatever game comes next.  If the AI does end up playing that move, it takes
+	// this search over instead of starting its own.
+	BackgroundSearch warming;
+	
+	bool firstFrame = true;
+	
+	// Speculative AI searches run while it's the player's turn.  See ponder().
+	std::map<std::size_t, BackgroundSearch> ponderings;
+	
+	// We only render a frame when something on the screen might have changed.
+	// The rest of the time, we sleep until an event comes in.
+	bool dirty = true;
+	int lastHoverTarget = -1;
+	
 	bool done = false;
 	while (!done)
 	{
 		bool mouseReleased = false;
-		SDL_Event event;
-		while (SDL_PollEvent(&event))
+		const auto handleEvent = [&](const SDL_Event& event)
 		{
 			switch(event.type)
 			{
@@ -109,6 +569,10 @@ int main()
 					{
 						case SDL_WINDOWEVENT_SIZE_CHANGED:
 							setViewport(window);
+							dirty = true;
+							break;
+						case SDL_WINDOWEVENT_EXPOSED:
+							dirty = true;
 							break;
 					}
 					break;
@@ -118,27 +582,75 @@ int main()
 				case SDL_QUIT:
 					done = true;
 					break;
+				default:
+					// A finished pondering frees a core for the next one.
+					if (event.type == aiFinishedEventType && (state == State::GAMEPLAY_AI_TURN_WAITING || state == State::GAMEPLAY_PLAYER_TURN))
+						dirty = true;
+					break;
 			}
+		};
+		
+		// A stepped search that isn't done yet needs the loop to keep coming back.
+		const bool stepping = steppedSearch && !steppedSearch->done();
+		
+		SDL_Event event;
+		if (!dirty && !stepping && SDL_WaitEventTimeout(&event, IDLE_TIMEOUT_MS))
+			handleEvent(event);
+		while (SDL_PollEvent(&event))
+			handleEvent(event);
+		
+		if (stepping)
+		{
+			const auto sliceBegin = std::chrono::steady_clock::now();
+			do steppedSearch->step(SEARCH_STEP_NODES);
+			while (!steppedSearch->done() && millisecondsBetween(sliceBegin, std::chrono::steady_clock::now()) < SEARCH_SLICE_MS);
+			if (steppedSearch->done()) dirty = true;
 		}
 		
 		Vector mouse = getMousePosition(window);
 		
+		// Whatever the mouse is highlighting, if anything.  Moving the mouse only
+		// changes the screen when this changes.
+		int hoverTarget = -1;
+		if (state == State::DIFFICULTY_SELECTION)
+		{
+			for (std::size_t index = 0; index < sizeof(DIFFICULTY_BUTTONS)/sizeof(*DIFFICULTY_BUTTONS); index++)
+				if (mouse.in(DIFFICULTY_BUTTONS[index].first, DIFFICULTY_BUTTONS[index].second)) hoverTarget = index;
+		}
+		else if (state == State::SYMBOL_SELECTION)
+		{
+			if (mouse.in(X_BUTTON.first, X_BUTTON.second)) hoverTarget = 0;
+			else if (mouse.in(O_BUTTON.first, O_BUTTON.second)) hoverTarget = 1;
+		}
+		else if (state == State::GAMEPLAY_PLAYER_TURN)
+			hoverTarget = placeUnder(mouse);
+		
+		if (hoverTarget != lastHoverTarget || mouseReleased) dirty = true;
+		lastHoverTarget = hoverTarget;
+		
+		frameCounter.show(window);
+		if (!dirty)
+		{
+			frameCounter.countSkipped();
+			continue;
+		}
+		dirty = false;
+		const State previousState = state;
+		
+		beginFrame(renderer);
 		glClear(GL_COLOR_BUFFER_BIT);
 		
 		if (state == State::DIFFICULTY_SELECTION)
 		{
-			std::vector<std::pair<Vector, Vector>> rectangles = {
-				{{-0.5, 0.125}, {0.5, 0.375}},
-				{{-0.5, -0.125}, {0.5, 0.125}},
-				{{-0.5, -0.375}, {0.5, -0.125}}
-			};
+			if (!options.singleThreaded && !warming.decision.valid())
+				warming = startSearch(GameState(), Symbol::X, MAXIMUM_DEPTHS[HARDEST_DIFFICULTY]);
 			
-			for (std::size_t index = 0; index < rectangles.size(); index++)
+			for (std::size_t index = 0; index < sizeof(DIFFICULTY_BUTTONS)/sizeof(*DIFFICULTY_BUTTONS); index++)
 			{
-				const auto& rectangle = rectangles[index];
+				const auto& rectangle = DIFFICULTY_BUTTONS[index];
 				if (mouse.in(rectangle.first, rectangle.second))
 				{
-					drawRectangle(shaderProgram, LIGHT_GRAY, rectangle.first, rectangle.second);
+					drawRectangle(renderer, LIGHT_GRAY, rectangle.first, rectangle.second);
 					if (mouseReleased)
 					{
 						difficultyLevel = index;
@@ -149,60 +661,80 @@ int main()
 			}
 			
 			// Draw difficulty selection bars.
-			drawPie(shaderProgram, GREEN, {-0.25, 0.25}, 0.0625, 0.0, PI*2);
-			drawPie(shaderProgram, YELLOW, {-0.25, 0.0}, 0.0625, 0.0, PI*2);
-			drawPie(shaderProgram, YELLOW, {0.0, 0.0}, 0.0625, 0.0, PI*2);
-			drawPie(shaderProgram, RED, {-0.25, -0.25}, 0.0625, 0.0, PI*2);
-			drawPie(shaderProgram, RED, {0.0, -0.25}, 0.0625, 0.0, PI*2);
-			drawPie(shaderProgram, RED, {0.25, -0.25}, 0.0625, 0.0, PI*2);
+			drawCircle(renderer, GREEN, {-0.25, 0.25}, 0.0625);
+			drawCircle(renderer, YELLOW, {-0.25, 0.0}, 0.0625);
+			drawCircle(renderer, YELLOW, {0.0, 0.0}, 0.0625);
+			drawCircle(renderer, RED, {-0.25, -0.25}, 0.0625);
+			drawCircle(renderer, RED, {0.0, -0.25}, 0.0625);
+			drawCircle(renderer, RED, {0.25, -0.25}, 0.0625);
 		}
 		
 		else if (state == State::SYMBOL_SELECTION)
 		{
-			if (mouse.in({-0.75, -0.25}, {-0.25, 0.25})) // Over left (X) side.
+			if (mouse.in(X_BUTTON.first, X_BUTTON.second)) // Over left (X) side.
 			{
-				drawRectangle(shaderProgram, LIGHT_GRAY, {-0.75, -0.25}, {-0.25, 0.25});
+				drawRectangle(renderer, LIGHT_GRAY, X_BUTTON.first, X_BUTTON.second);
 				if (mouseReleased)
 				{
 					playerSymbol = Symbol::X;
 					state = State::GAMEPLAY_PLAYER_TURN;
+					cancelSearch(warming);
 				}
 			}
 			
-			if (mouse.in({0.75, 0.25}, {0.25, -0.25})) // Over right (O) side.
+			if (mouse.in(O_BUTTON.first, O_BUTTON.second)) // Over right (O) side.
 			{
-				drawRectangle(shaderProgram, LIGHT_GRAY, {0.75, 0.25}, {0.25, -0.25});
+				drawRectangle(renderer, LIGHT_GRAY, O_BUTTON.first, O_BUTTON.second);
 				if (mouseReleased)
 				{
 					playerSymbol = Symbol::O;
-					state = State::GAMEPLAY_AI_TURN_BEGIN;
+					if (difficultyLevel == HARDEST_DIFFICULTY && warming.decision.valid())
+					{
+						aiSearch = std::move(warming);
+						state = State::GAMEPLAY_AI_TURN_WAITING;
+					}
+					else
+					{
+						cancelSearch(warming);
+						state = State::GAMEPLAY_AI_TURN_BEGIN;
+					}
 				}
 			}
 			
-			drawX(shaderProgram, WHITE, {-0.5, 0});
-			drawCappedLine(shaderProgram, WHITE, {0, -0.5}, {0, 0.5}, 0.05);
-			drawO(shaderProgram, WHITE, {0.5, 0});
+			drawX(renderer, WHITE, {-0.5, 0});
+			drawDivider(renderer, WHITE);
+			drawO(renderer, WHITE, {0.5, 0});
 		}
 		
 		else if (state == State::GAMEPLAY_PLAYER_TURN || state == State::GAMEPLAY_AI_TURN_BEGIN || state == State::GAMEPLAY_AI_TURN_WAITING)
 		{
 			if (state == State::GAMEPLAY_PLAYER_TURN)
 			{
-				unsigned int row = (unsigned int)((-mouse.y/INNER_SIZE+1)*2);
-				unsigned int column = (unsigned int)((mouse.x/INNER_SIZE+1)*2);
-				if (row > 3) row = 3;
-				if (column > 3) column = 3;
-				const unsigned int place = row*4+column;
+				if (!options.singleThreaded)
+					ponder(ponderings, gameState, playerSymbol, MAXIMUM_DEPTHS[difficultyLevel]);
 				
+				const unsigned int place = placeUnder(mouse);
 				if (gameState.symbols[place] == Symbol::EMPTY)
 				{
-					drawSymbol(shaderProgram, YELLOW, playerSymbol, spaceCenter(row, column));
+					drawSymbol(renderer, YELLOW, playerSymbol, spaceCenter(place/4, place%4));
 					
 					if (mouseReleased)
 					{
 						Action action = {playerSymbol, place};
 						gameState = gameState.apply(action);
+						
+						// If we already started thinking about this move, keep that
+						// search going and throw away the others.
+						const auto matchingPondering = ponderings.find(place);
+						if (matchingPondering != ponderings.end())
+						{
+							aiSearch = std::move(matchingPondering->second);
+							ponderings.erase(matchingPondering);
+						}
+						cancelSearches(ponderings);
+						
 						if (gameState.terminal()) state = State::GAME_OVER;
+						else if (aiSearch.decision.valid()) state = State::GAMEPLAY_AI_TURN_WAITING;
 						else state = State::GAMEPLAY_AI_TURN_BEGIN;
 					}
 				}
@@ -210,23 +742,30 @@ int main()
 			
 			else if (state == State::GAMEPLAY_AI_TURN_BEGIN)
 			{
-				// Set up the AI's turn.  We'll wait while it thinks in another thread.
-				const unsigned int maximumDepths[] = {0, 1, 6};
-				aiDecision = std::async(std::launch::async, findBestAction, gameState, improvedEvaluator, opponentOf(playerSymbol), maximumDepths[difficultyLevel]);
+				// Set up the AI's turn.  We'll wait while it thinks in another thread,
+				// or between frames in single-threaded mode.
+				if (options.singleThreaded)
+					steppedSearch.reset(new ResumableSearch(gameState, improvedEvaluator, opponentOf(playerSymbol), MAXIMUM_DEPTHS[difficultyLevel]));
+				else
+					aiSearch = startSearch(gameState, opponentOf(playerSymbol), MAXIMUM_DEPTHS[difficultyLevel]);
 				state = State::GAMEPLAY_AI_TURN_WAITING;
 			}
 			
 			else if (state == State::GAMEPLAY_AI_TURN_WAITING)
 			{
-				if (aiDecision.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready)
+				const bool decided = steppedSearch
+					? steppedSearch->done()
+					: aiSearch.decision.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready;
+				if (decided)
 				{
-					gameState = gameState.apply(aiDecision.get());
+					gameState = gameState.apply(steppedSearch ? finishSteppedSearch(*steppedSearch, opponentOf(playerSymbol)) : finishSearch(aiSearch));
+					steppedSearch.reset();
 					if (gameState.terminal()) state = State::GAME_OVER;
 					else state = State::GAMEPLAY_PLAYER_TURN;
 				}
 			}
 			
-			drawGame(shaderProgram, gameState, WHITE);	
+			drawGame(renderer, gameState, WHITE);	
 		}
 		
 		else if (state == State::GAME_OVER)
@@ -234,15 +773,43 @@ int main()
 			Color gridColor = YELLOW;
 			if (gameState.winner() == playerSymbol) gridColor = GREEN;
 			else if (gameState.winner() == opponentOf(playerSymbol)) gridColor = RED;
-			drawGame(shaderProgram, gameState, gridColor);
+			drawGame(renderer, gameState, gridColor);
 			
 			if (mouseReleased)
 			{
+				cancelSearches(ponderings);
 				gameState = GameState();
 				state = State::DIFFICULTY_SELECTION;
 			}
 		}
 		
+		endFrame(renderer);
+		frameCounter.countRendered(renderer.frame);
 		SDL_GL_SwapWindow(window);
+		
+		if (firstFrame)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			std::cout << "Time to first frame: " << millisecondsBetween(launchTime, now) << " ms"
+			          << " (window and context: " << millisecondsBetween(windowBegin, windowEnd) << " ms"
+			          << ", shader program: " << millisecondsBetween(windowEnd, shaderEnd) << " ms"
+			          << (shaderProgramCached ? " from cache" : " compiled") << ")" << std::endl;
+			firstFrame = false;
+		}
+		
+		// What we just drew was for the old state, so draw the new one right away.
+		// The same goes for a search that finished before we got to look at it.
+		if (state != previousState) dirty = true;
+		else if (state == State::GAMEPLAY_AI_TURN_WAITING && aiSearch.decision.valid()
+		         && aiSearch.decision.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready)
+			dirty = true;
 	}
+	
+	destroyRenderer(renderer);
+	
+	// Don't make the player wait for searches that nobody will look at.
+	cancelSearches(ponderings);
+	cancelSearch(warming);
+	if (aiSearch.decision.valid())
+		*aiSearch.cancelled = true;
 }
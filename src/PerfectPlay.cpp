@@ -0,0 +1,87 @@
+#include "PerfectPlay.hpp"
+#include "AI.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+	// Generated by tools/GeneratePerfectPlay.cpp when the program is built.
+	#include "PerfectPlayTable.inc"
+	
+	static_assert(sizeof(PERFECT_PLAY_TABLE)*4 >= PERFECT_PLAY_ENTRY_COUNT, "The perfect-play table is out of date.");
+	
+	unsigned int entryAt(const std::size_t index)
+	{
+		return PERFECT_PLAY_TABLE[index/32] >> (index%32*2) & 3;
+	}
+	
+	constexpr unsigned int NOT_IN_TABLE = PERFECT_PLAY_GAME_OVER + 1;
+	
+	// Returns state's entry, or NOT_IN_TABLE.
+	unsigned int lookUp(const GameState& state)
+	{
+		const std::size_t index = perfectPlayIndex(state);
+		return index == PERFECT_PLAY_ENTRY_COUNT ? NOT_IN_TABLE : entryAt(index);
+	}
+}
+
+PerfectPlayResult findPerfectAction(const GameState& state, const Symbol symbol)
+{
+	PerfectPlayResult result;
+	const auto xCount = std::count(state.symbols.begin(), state.symbols.end(), Symbol::X);
+	const auto oCount = std::count(state.symbols.begin(), state.symbols.end(), Symbol::O);
+	const auto empties = state.symbols.size() - xCount - oCount;
+	if (empties > PERFECT_PLAY_MAXIMUM_LOOKUP_EMPTIES || state.terminal() || symbol != (xCount == oCount ? Symbol::X : Symbol::O))
+		return result;
+	
+	for (const auto& action: state.possibleActionsFor(symbol))
+	{
+		// The opponent's outcome after our move is the opposite of ours.
+		const GameState next = state.apply(action);
+		Outcome outcome = next.outcomeFor(symbol);
+		if (!next.terminal())
+		{
+			const unsigned int entry = lookUp(next);
+			if (entry > unsigned(Outcome::WIN)) return result;
+			outcome = Outcome(2 - entry);
+		}
+		
+		if (!result.found || outcome > result.outcome)
+		{
+			result.found = true;
+			result.outcome = outcome;
+			result.action = action;
+		}
+	}
+	return result;
+}
+
+std::size_t verifyPerfectPlayTable(std::ostream& log)
+{
+	std::size_t checkedCount = 0;
+	std::size_t wrongCount = 0;
+	forEachPerfectPlayPosition([&](const GameState& state)
+	{
+		const unsigned int entry = lookUp(state);
+		unsigned int expected = PERFECT_PLAY_GAME_OVER;
+		if (!state.terminal())
+		{
+			// Unlimited depth means every leaf is the end of the game, where the
+			// improved evaluator gives exactly a win, a loss or 0 for a draw.
+			const auto empties = std::count(state.symbols.begin(), state.symbols.end(), Symbol::EMPTY);
+			const Symbol mover = empties % 2 == 0 ? Symbol::X : Symbol::O;
+			const Score score = minimax(state, improvedEvaluator, mover, unsigned(empties), -SCORE_MAX, SCORE_MAX).score;
+			expected = unsigned(score > 0 ? Outcome::WIN : score < 0 ? Outcome::LOSS : Outcome::DRAW);
+		}
+		
+		checkedCount++;
+		if (entry != expected)
+		{
+			if (wrongCount < 10) log << "Wrong perfect-play entry " << perfectPlayIndex(state) << ": " << entry << " instead of " << expected << std::endl;
+			wrongCount++;
+		}
+	});
+	log << "Checked " << checkedCount << " perfect-play entries against minimax(); " << wrongCount << " were wrong." << std::endl;
+	return wrongCount;
+}
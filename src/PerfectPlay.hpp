@@ -0,0 +1,37 @@
+#ifndef PERFECT_PLAY_HPP_INCLUDED
+#define PERFECT_PLAY_HPP_INCLUDED
+
+#include "Game.hpp"
+#include "PerfectPlayIndex.hpp"
+#include <cstddef>
+#include <iostream>
+
+// The exact solution of every late-game position, worked out when the program is
+// built and embedded in it as a read-only table, so looking one up costs no file
+// I/O or startup time.  Table entries go up to PERFECT_PLAY_MAXIMUM_EMPTIES empty
+// spaces, and a position with one more can be solved from its children's entries.
+constexpr unsigned int PERFECT_PLAY_MAXIMUM_LOOKUP_EMPTIES = PERFECT_PLAY_MAXIMUM_EMPTIES + 1;
+
+// Returned by findPerfectAction().
+struct PerfectPlayResult
+{
+	// Whether the position could be looked up.  If not, nothing else here means anything.
+	bool found = false;
+	
+	// The best outcome symbol can force.
+	Outcome outcome = Outcome::LOSS;
+	
+	// The first action that forces outcome.
+	Action action;
+};
+
+// Looks up the best action for symbol, who moves next.  Nothing is found if state
+// has more than PERFECT_PLAY_MAXIMUM_LOOKUP_EMPTIES empty spaces, if it's over, or
+// if it isn't actually symbol's turn.
+PerfectPlayResult findPerfectAction(const GameState& state, Symbol symbol);
+
+// Checks every entry in the table against minimax() with unlimited depth, writes
+// a summary to log and returns the number of entries that disagree.
+std::size_t verifyPerfectPlayTable(std::ostream& log);
+
+#endif
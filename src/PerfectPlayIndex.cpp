@@ -0,0 +1,91 @@
+#include "PerfectPlayIndex.hpp"
+
+#include <vector>
+
+// Entries are grouped by number of empty spaces, then by which spaces are empty,
+// then by which of the other spaces have X's.  Each choice of spaces is numbered
+// by its rank in colexicographic order: the sorted choice {c0, c1, c2, ...} has the
+// rank binomial(c0, 1) + binomial(c1, 2) + binomial(c2, 3) + ...
+
+namespace
+{
+	std::size_t rankOf(const std::vector<std::size_t>& choice)
+	{
+		std::size_t rank = 0;
+		for (std::size_t index = 0; index < choice.size(); index++)
+			rank += binomial(choice[index], index+1);
+		return rank;
+	}
+	
+	// Returns the choice of size things whose rank is rank.
+	std::vector<std::size_t> choiceOf(std::size_t rank, const std::size_t size)
+	{
+		std::vector<std::size_t> choice(size);
+		for (std::size_t index = size; index-- > 0;)
+		{
+			std::size_t element = index;
+			while (binomial(element+1, index+1) <= rank) element++;
+			rank -= binomial(element, index+1);
+			choice[index] = element;
+		}
+		return choice;
+	}
+	
+	std::size_t firstIndexFor(const unsigned int empties)
+	{
+		std::size_t index = 0;
+		for (unsigned int fewerEmpties = 1; fewerEmpties < empties; fewerEmpties++)
+			index += perfectPlayEntryCount(fewerEmpties);
+		return index;
+	}
+}
+
+std::size_t perfectPlayIndex(const GameState& state)
+{
+	std::vector<std::size_t> emptyPlaces, xOrdinals;
+	std::size_t oCount = 0;
+	for (std::size_t place = 0; place < state.symbols.size(); place++)
+	{
+		if (state.symbols[place] == Symbol::EMPTY) emptyPlaces.push_back(place);
+		else if (state.symbols[place] == Symbol::X) xOrdinals.push_back(place - emptyPlaces.size());
+		else oCount++;
+	}
+	
+	const unsigned int empties = emptyPlaces.size();
+	const std::size_t pieces = 16 - empties;
+	if (empties == 0 || empties > PERFECT_PLAY_MAXIMUM_EMPTIES || xOrdinals.size() != (pieces+1)/2 || oCount != pieces/2)
+		return PERFECT_PLAY_ENTRY_COUNT;
+	
+	return firstIndexFor(empties) + rankOf(emptyPlaces)*binomial(pieces, xOrdinals.size()) + rankOf(xOrdinals);
+}
+
+void forEachPerfectPlayPosition(const std::function<void(const GameState&)>& visit)
+{
+	for (unsigned int empties = 1; empties <= PERFECT_PLAY_MAXIMUM_EMPTIES; empties++)
+	{
+		const std::size_t pieces = 16 - empties;
+		const std::size_t xCount = (pieces+1)/2;
+		for (std::size_t emptyRank = 0; emptyRank < binomial(16, empties); emptyRank++)
+		{
+			const auto emptyPlaces = choiceOf(emptyRank, empties);
+			for (std::size_t xRank = 0; xRank < binomial(pieces, xCount); xRank++)
+			{
+				const auto xOrdinals = choiceOf(xRank, xCount);
+				GameState state;
+				std::size_t nextEmpty = 0, nextX = 0, ordinal = 0;
+				for (std::size_t place = 0; place < state.symbols.size(); place++)
+				{
+					if (nextEmpty < empties && emptyPlaces[nextEmpty] == place)
+					{
+						nextEmpty++;
+						continue;
+					}
+					const bool x = nextX < xCount && xOrdinals[nextX] == ordinal++;
+					if (x) nextX++;
+					state.symbols[place] = x ? Symbol::X : Symbol::O;
+				}
+				visit(state);
+			}
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef PERFECT_PLAY_INDEX_HPP_INCLUDED
+#define PERFECT_PLAY_INDEX_HPP_INCLUDED
+
+#include "Game.hpp"
+#include <cstddef>
+#include <functional>
+
+// The perfect-play table has an entry for every 4x4 position with 1 to this many
+// empty spaces, and the right number of each symbol for X having moved first.
+// It's generated when the program is built; see PerfectPlay.hpp.
+constexpr unsigned int PERFECT_PLAY_MAXIMUM_EMPTIES = 3;
+
+// Each entry is 2 bits, either the Outcome for the player to move or this, for
+// positions where the game is already over.  Entries are packed 32 to a 64-bit
+// word, starting from the lowest bits.
+constexpr unsigned int PERFECT_PLAY_GAME_OVER = 3;
+
+// The number of ways to choose k things out of n.
+constexpr std::size_t binomial(const std::size_t n, const std::size_t k)
+{
+	if (k > n) return 0;
+	std::size_t result = 1;
+	for (std::size_t index = 1; index <= k; index++)
+		result = result*(n - k + index)/index;
+	return result;
+}
+
+// The number of positions with empties empty spaces that get an entry: every
+// choice of empty spaces, times every choice of X's spaces among the rest.
+constexpr std::size_t perfectPlayEntryCount(const unsigned int empties)
+{
+	return binomial(16, empties)*binomial(16 - empties, (16 - empties + 1)/2);
+}
+
+constexpr std::size_t PERFECT_PLAY_ENTRY_COUNT = perfectPlayEntryCount(1) + perfectPlayEntryCount(2) + perfectPlayEntryCount(3);
+static_assert(PERFECT_PLAY_MAXIMUM_EMPTIES == 3, "PERFECT_PLAY_ENTRY_COUNT has to count every table entry.");
+
+// Returns the index of state's entry in the table, or PERFECT_PLAY_ENTRY_COUNT if
+// it doesn't have one.
+std::size_t perfectPlayIndex(const GameState& state);
+
+// Calls visit for every position that has an entry, in order of index.
+void forEachPerfectPlayPosition(const std::function<void(const GameState&)>& visit);
+
+#endif
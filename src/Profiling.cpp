@@ -0,0 +1,334 @@
+#include "Profiling.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+	std::atomic<bool> profilingEnabled(false);
+	
+	const char* const COUNTER_NAMES[COUNTER_KIND_COUNT] = {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+	const char* const PHASE_NAMES[SEARCH_PHASE_COUNT] = {"move generation", "apply", "terminal check", "evaluation"};
+	
+	constexpr std::uint64_t cacheReadMisses(const std::uint64_t cache)
+	{
+		return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+	}
+	
+	// The perf event type and config of each CounterKind.
+	const std::pair<std::uint32_t, std::uint64_t> COUNTER_EVENTS[COUNTER_KIND_COUNT] = {
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		{PERF_TYPE_HW_CACHE, cacheReadMisses(PERF_COUNT_HW_CACHE_L1D)},
+		{PERF_TYPE_HW_CACHE, cacheReadMisses(PERF_COUNT_HW_CACHE_LL)},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+	};
+
+#if defined(__x86_64__) || defined(__i386__)
+	constexpr bool USER_SPACE_READS_SUPPORTED = true;
+	
+	std::uint64_t readPerformanceCounter(const std::uint32_t counter)
+	{
+		std::uint32_t low, high;
+		asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+		return std::uint64_t(high) << 32 | low;
+	}
+#else
+	constexpr bool USER_SPACE_READS_SUPPORTED = false;
+	
+	std::uint64_t readPerformanceCounter(std::uint32_t)
+	{
+		return 0;
+	}
+#endif
+	
+	// Reads a counter through its perf mmap page with rdpmc, without entering the
+	// kernel, following the protocol in <linux/perf_event.h>.  The kernel bumps
+	// lock whenever it changes the page, so we retry if it did so while we read.
+	std::uint64_t readMappedCounter(const volatile perf_event_mmap_page* const page)
+	{
+		std::uint32_t sequence;
+		std::uint64_t count;
+		do
+		{
+			sequence = page->lock;
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			
+			// The index is 0 while the counter isn't on the CPU, and then the offset
+			// holds the whole count.
+			const std::uint32_t index = page->index;
+			count = page->offset;
+			if (index != 0)
+			{
+				const unsigned int shift = 64 - page->pmc_width;
+				count += std::uint64_t(std::int64_t(readPerformanceCounter(index-1) << shift) >> shift);
+			}
+			
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+		}
+		while (page->lock != sequence);
+		return count;
+	}
+	
+	// One thread's counters, opened as a group so that they're all read with one
+	// system call.  Only user-space events count, so the system calls themselves
+	// barely show up in the totals.  Whatever this CPU or kernel doesn't support is
+	// left out.
+	//
+	// A system call is still far too much for reading the counters around every
+	// phase of every node, since the kernel's own cache misses would swamp the
+	// phases'.  So each counter's mmap page is mapped too, and if the kernel allows
+	// it, phases read the counters with rdpmc instead.
+	class CounterGroup
+	{
+		public:
+			CounterGroup()
+			{
+				for (std::size_t kind = 0; kind < COUNTER_KIND_COUNT; kind++)
+				{
+					perf_event_attr attributes;
+					std::memset(&attributes, 0, sizeof(attributes));
+					attributes.size = sizeof(attributes);
+					attributes.type = COUNTER_EVENTS[kind].first;
+					attributes.config = COUNTER_EVENTS[kind].second;
+					attributes.disabled = descriptors.empty(); // The group starts when its leader does.
+					attributes.exclude_kernel = 1;
+					attributes.exclude_hv = 1;
+					attributes.read_format = PERF_FORMAT_GROUP;
+					
+					const int leader = descriptors.empty() ? -1 : descriptors.front();
+					const int descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+					if (descriptor < 0)
+					{
+						if (error.empty()) error = std::string("perf_event_open: ") + std::strerror(errno);
+						continue;
+					}
+					descriptors.push_back(descriptor);
+					kinds.push_back(kind);
+				}
+				
+				if (!descriptors.empty())
+				{
+					ioctl(descriptors.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+					ioctl(descriptors.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+				}
+				
+				mapPages();
+			}
+			
+			~CounterGroup()
+			{
+				unmapPages();
+				for (const int descriptor: descriptors)
+					close(descriptor);
+			}
+			
+			CounterGroup(const CounterGroup&) = delete;
+			CounterGroup& operator=(const CounterGroup&) = delete;
+			
+			bool available() const
+			{
+				return !descriptors.empty();
+			}
+			
+			const std::string& unavailableReason() const
+			{
+				return error;
+			}
+			
+			bool supports(const std::size_t kind) const
+			{
+				return std::find(kinds.begin(), kinds.end(), kind) != kinds.end();
+			}
+			
+			// Leaves values alone if the counters can't be read.
+			void read(CounterValues& values) const
+			{
+				// The group's count, then each counter in the order they were opened.
+				std::uint64_t buffer[1 + COUNTER_KIND_COUNT];
+				const auto size = (1 + kinds.size())*sizeof(std::uint64_t);
+				if (!available() || ::read(descriptors.front(), buffer, size) != ssize_t(size)) return;
+				for (std::size_t index = 0; index < kinds.size(); index++)
+					values.values[kinds[index]] = buffer[1 + index];
+			}
+			
+			// Whether readInUserSpace() works.
+			bool userSpaceReadable() const
+			{
+				return !pages.empty();
+			}
+			
+			// Like read(), but without a system call.  Only if userSpaceReadable().
+			void readInUserSpace(CounterValues& values) const
+			{
+				for (std::size_t index = 0; index < pages.size(); index++)
+					values.values[kinds[index]] = readMappedCounter(pages[index]);
+			}
+		
+		private:
+			// Leaves pages empty unless every counter can be read with rdpmc.
+			void mapPages()
+			{
+				if (!USER_SPACE_READS_SUPPORTED) return;
+				
+				const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+				for (const int descriptor: descriptors)
+				{
+					void* const page = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, descriptor, 0);
+					if (page == MAP_FAILED)
+					{
+						unmapPages();
+						return;
+					}
+					pages.push_back(static_cast<perf_event_mmap_page*>(page));
+					if (!pages.back()->cap_user_rdpmc)
+					{
+						unmapPages();
+						return;
+					}
+				}
+			}
+			
+			void unmapPages()
+			{
+				const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+				for (perf_event_mmap_page* const page: pages)
+					munmap(page, pageSize);
+				pages.clear();
+			}
+			
+			std::vector<int> descriptors;
+			std::vector<std::size_t> kinds;
+			std::vector<perf_event_mmap_page*> pages; // One per descriptor, or none.
+			std::string error;
+	};
+	
+	void addDifference(CounterValues& sum, const CounterValues& begin, const CounterValues& end)
+	{
+		for (std::size_t kind = 0; kind < COUNTER_KIND_COUNT; kind++)
+			sum.values[kind] += end.values[kind] - begin.values[kind];
+	}
+	
+	// Divides by the profile's node count, unless it's 0.
+	void writePerNode(std::ostream& output, const SearchProfile& profile, const CounterValues& values)
+	{
+		const double nodeCount = std::max(1u, profile.nodeCount);
+		for (std::size_t kind = 0; kind < COUNTER_KIND_COUNT; kind++)
+		{
+			output << (kind == 0 ? "" : ", ") << COUNTER_NAMES[kind] << ": ";
+			if (profile.supported[kind]) output << values.values[kind]/nodeCount;
+			else output << "n/a";
+		}
+	}
+}
+
+struct ProfiledSearch::State
+{
+	CounterGroup counters;
+	CounterValues begin;
+	SearchProfile profile;
+};
+
+thread_local ProfiledSearch::State* ProfiledSearch::current = nullptr;
+
+std::ostream& operator<<(std::ostream& output, const SearchProfile& profile)
+{
+	if (!profile.available)
+		return output << "profile: unavailable (" << profile.unavailableReason << ")";
+	
+	const auto flags = output.flags(std::ios::fixed);
+	const auto precision = output.precision(profile.nodeCount == 0 ? 0 : 2);
+	const char* const unit = profile.nodeCount == 0 ? " totals: " : " per node: ";
+	output << "profile" << unit;
+	writePerNode(output, profile, profile.total);
+	
+	bool phasesCounted = false;
+	for (std::size_t phase = 0; phase < SEARCH_PHASE_COUNT; phase++)
+		for (std::size_t kind = 0; kind < COUNTER_KIND_COUNT; kind++)
+			phasesCounted |= profile.phases[phase].values[kind] != 0;
+	
+	for (std::size_t phase = 0; phase < SEARCH_PHASE_COUNT && phasesCounted; phase++)
+	{
+		output << "; " << PHASE_NAMES[phase] << unit;
+		writePerNode(output, profile, profile.phases[phase]);
+	}
+	if (!profile.phasesAvailable)
+		output << "; phases: unavailable (counters can't be read from user space)";
+	output.flags(flags);
+	output.precision(precision);
+	return output;
+}
+
+void setSearchProfiling(const bool enabled)
+{
+	profilingEnabled = enabled;
+}
+
+ProfiledSearch::ProfiledSearch()
+{
+	if (!profilingEnabled || current) return;
+	
+	state = new State;
+	state->profile.available = state->counters.available();
+	state->profile.unavailableReason = state->counters.unavailableReason();
+	state->profile.phasesAvailable = state->counters.userSpaceReadable();
+	for (std::size_t kind = 0; kind < COUNTER_KIND_COUNT; kind++)
+		state->profile.supported[kind] = state->counters.supports(kind);
+	
+	if (state->profile.available)
+	{
+		state->counters.read(state->begin);
+		current = state;
+	}
+}
+
+ProfiledSearch::~ProfiledSearch()
+{
+	if (current == state) current = nullptr;
+	delete state;
+}
+
+bool ProfiledSearch::active() const
+{
+	return state != nullptr;
+}
+
+SearchProfile ProfiledSearch::profile() const
+{
+	if (!state) return SearchProfile();
+	
+	SearchProfile profile = state->profile;
+	if (profile.available)
+	{
+		CounterValues now;
+		state->counters.read(now);
+		addDifference(profile.total, state->begin, now);
+	}
+	return profile;
+}
+
+PhaseScope::PhaseScope(const SearchPhase phase):
+	phase(phase),
+	counting(ProfiledSearch::current != nullptr && ProfiledSearch::current->profile.phasesAvailable)
+{
+	if (counting) ProfiledSearch::current->counters.readInUserSpace(begin);
+}
+
+PhaseScope::~PhaseScope()
+{
+	if (!counting) return;
+	
+	CounterValues end;
+	ProfiledSearch::current->counters.readInUserSpace(end);
+	addDifference(ProfiledSearch::current->profile.phases[std::size_t(phase)], begin, end);
+}
@@ -0,0 +1,120 @@
+#ifndef PROFILING_HPP_INCLUDED
+#define PROFILING_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iostream>
+
+// Opt-in profiling of AI searches with the CPU's hardware performance counters,
+// through Linux's perf_event_open().  Profiling is off unless setSearchProfiling()
+// turns it on, and costs next to nothing when it's off.
+
+// The parts of minimax() that get counted separately.
+enum class SearchPhase
+{
+	MOVE_GENERATION,
+	APPLY,
+	TERMINAL_CHECK,
+	EVALUATION
+};
+
+constexpr std::size_t SEARCH_PHASE_COUNT = 4;
+
+// The hardware events counted.
+enum class CounterKind
+{
+	CYCLES,
+	INSTRUCTIONS,
+	L1D_MISSES,
+	LLC_MISSES,
+	BRANCH_MISSES
+};
+
+constexpr std::size_t COUNTER_KIND_COUNT = 5;
+
+struct CounterValues
+{
+	std::uint64_t values[COUNTER_KIND_COUNT] = {};
+};
+
+// Everything counted during one profiled search.
+struct SearchProfile
+{
+	// Whether any counters could be opened at all.  If not, unavailableReason says
+	// why, and nothing else here means anything.
+	bool available = false;
+	std::string unavailableReason;
+	
+	// Which kinds of counter this CPU and kernel support.  Unsupported kinds read 0.
+	bool supported[COUNTER_KIND_COUNT] = {};
+	
+	// Whether phases are counted at all.  They're only counted where the counters
+	// can be read with rdpmc, without a system call; otherwise only total is.
+	bool phasesAvailable = false;
+	
+	CounterValues total;
+	CounterValues phases[SEARCH_PHASE_COUNT];
+	
+	// What the counts are divided by when they're written out.  Set by whoever
+	// knows how many nodes the search generated, and left at 0 by searches that
+	// don't count nodes.
+	unsigned int nodeCount = 0;
+};
+
+// Writes the profile's counts per node, as a whole and for each phase, in the same
+// "name: value" format as findBestAction()'s statistics.  Without a node count, the
+// totals are written instead.  Phases are left out if nothing was counted in any of
+// them, since only minimax() counts phases, and said to be unavailable if they
+// couldn't be counted.
+std::ostream& operator<<(std::ostream& output, const SearchProfile& profile);
+
+// Turns profiling on or off for searches started from now on, in every thread.
+void setSearchProfiling(bool enabled);
+
+// Profiles whatever the calling thread does while it's alive, if profiling is on.
+// Profiles don't nest; an inner one does nothing.
+class ProfiledSearch
+{
+	public:
+		ProfiledSearch();
+		~ProfiledSearch();
+		
+		ProfiledSearch(const ProfiledSearch&) = delete;
+		ProfiledSearch& operator=(const ProfiledSearch&) = delete;
+		
+		// Whether this search is being profiled, even if the counters turned out to
+		// be unavailable.  Only an active search has a profile to report.
+		bool active() const;
+		
+		// Returns what's been counted so far.
+		SearchProfile profile() const;
+	
+	private:
+		friend class PhaseScope;
+		struct State;
+		
+		// The calling thread's active profile, if it has one.
+		static thread_local State* current;
+		
+		State* state = nullptr;
+};
+
+// Adds what the calling thread does while it's alive to phase, if the thread is
+// running a ProfiledSearch.
+class PhaseScope
+{
+	public:
+		explicit PhaseScope(SearchPhase phase);
+		~PhaseScope();
+		
+		PhaseScope(const PhaseScope&) = delete;
+		PhaseScope& operator=(const PhaseScope&) = delete;
+	
+	private:
+		const SearchPhase phase;
+		CounterValues begin;
+		bool counting;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "ProofNumber.hpp"
+
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	typedef std::uint32_t ProofNumber;
+	constexpr ProofNumber INFINITE = std::numeric_limits<ProofNumber>::max();
+	
+	// Adds without overflowing past INFINITE.
+	ProofNumber add(const ProofNumber left, const ProofNumber right)
+	{
+		return left >= INFINITE - right ? INFINITE : left + right;
+	}
+	
+	// Nodes don't store their game state.  The search recreates it on the way
+	// down from the root, which keeps nodes small enough to have lots of them.
+	struct Node
+	{
+		// The number of leaves that would have to be proven to prove this node,
+		// and likewise for disproving it.
+		ProofNumber proof = 1;
+		ProofNumber disproof = 1;
+		
+		// Children are stored next to each other.  The root is node 0, so no
+		// child can be, and a firstChild of 0 means the node hasn't been expanded.
+		std::uint32_t firstChild = 0;
+		std::uint8_t childCount = 0;
+		
+		// The place the move leading to this node was made on.
+		std::uint8_t place = 0;
+	};
+	
+	// Tries to prove that symbol, moving first from root, can force at least goal.
+	// "OR" nodes are where symbol is moving (one good move is enough), and "AND"
+	// nodes are where the opponent is moving (every reply needs an answer).
+	class ProofNumberSearch
+	{
+		public:
+			ProofNumberSearch(const GameState& root, const Symbol symbol, const Outcome goal, const std::size_t nodeLimit):
+				root(root), symbol(symbol), goal(goal), nodeLimit(nodeLimit), nodes(1)
+			{
+			}
+			
+			// Returns false if the search ran out of nodes or was cancelled.
+			bool run(const std::atomic<bool>* const cancelled)
+			{
+				std::vector<std::uint32_t> path;
+				while (nodes[0].proof != 0 && nodes[0].disproof != 0)
+				{
+					if (cancelled && *cancelled) return false;
+					
+					// Walk down to the most-proving node.
+					path.assign(1, 0);
+					GameState state = root;
+					Symbol turn = symbol;
+					while (nodes[path.back()].firstChild != 0)
+					{
+						const Node& node = nodes[path.back()];
+						const bool orNode = path.size() % 2 == 1;
+						std::uint32_t best = node.firstChild;
+						for (std::uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++)
+						{
+							if (orNode ? nodes[child].proof < nodes[best].proof : nodes[child].disproof < nodes[best].disproof)
+								best = child;
+						}
+						state = state.apply({turn, nodes[best].place});
+						turn = opponentOf(turn);
+						path.push_back(best);
+					}
+					
+					if (!expand(path.back(), state, turn)) return false;
+					
+					// Back the new numbers up to the root.
+					for (std::size_t depth = path.size(); depth-- > 0;)
+						update(nodes[path[depth]], depth % 2 == 0);
+				}
+				return true;
+			}
+			
+			bool proven() const
+			{
+				return nodes[0].proof == 0;
+			}
+			
+			// Returns the place of the first proven move from the root.  Only
+			// meaningful if proven().
+			std::size_t provenPlace() const
+			{
+				for (std::uint32_t child = nodes[0].firstChild; child < nodes[0].firstChild + nodes[0].childCount; child++)
+					if (nodes[child].proof == 0) return nodes[child].place;
+				return 0;
+			}
+			
+			std::size_t nodeCount() const
+			{
+				return nodes.size();
+			}
+		
+		private:
+			// Generates and evaluates every child of nodes[index].  Returns false if
+			// they wouldn't fit.
+			bool expand(const std::uint32_t index, const GameState& state, const Symbol turn)
+			{
+				const auto actions = state.possibleActionsFor(turn);
+				if (nodes.size() + actions.size() > nodeLimit) return false;
+				
+				const std::uint32_t firstChild = nodes.size();
+				for (const auto& action: actions)
+				{
+					Node child;
+					child.place = action.place;
+					const GameState childState = state.apply(action);
+					if (childState.terminal())
+					{
+						const bool goalReached = childState.outcomeFor(symbol) >= goal;
+						child.proof = goalReached ? 0 : INFINITE;
+						child.disproof = goalReached ? INFINITE : 0;
+					}
+					nodes.push_back(child);
+				}
+				
+				nodes[index].firstChild = firstChild;
+				nodes[index].childCount = actions.size();
+				return true;
+			}
+			
+			void update(Node& node, const bool orNode)
+			{
+				ProofNumber proof = orNode ? INFINITE : 0;
+				ProofNumber disproof = orNode ? 0 : INFINITE;
+				for (std::uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++)
+				{
+					if (orNode)
+					{
+						proof = std::min(proof, nodes[child].proof);
+						disproof = add(disproof, nodes[child].disproof);
+					}
+					else
+					{
+						proof = add(proof, nodes[child].proof);
+						disproof = std::min(disproof, nodes[child].disproof);
+					}
+				}
+				node.proof = proof;
+				node.disproof = disproof;
+			}
+			
+			const GameState root;
+			const Symbol symbol;
+			const Outcome goal;
+			const std::size_t nodeLimit;
+			std::vector<Node> nodes;
+	};
+}
+
+ProofNumberResult solveExactly(const GameState& state,
+                               const Symbol symbol,
+                               const std::size_t nodeLimit,
+                               const std::atomic<bool>* const cancelled)
+{
+	ProofNumberResult result;
+	result.action = {symbol, state.possibleActionsFor(symbol).front().place};
+	
+	// Try for the best outcome first.  Failing to prove a win still leaves a draw
+	// to prove or disprove; failing to prove a draw means every move loses.
+	for (const Outcome goal: {Outcome::WIN, Outcome::DRAW})
+	{
+		ProofNumberSearch search(state, symbol, goal, nodeLimit);
+		const bool finished = search.run(cancelled);
+		result.nodeCount += search.nodeCount();
+		if (!finished) return result;
+		
+		if (search.proven())
+		{
+			result.solved = true;
+			result.outcome = goal;
+			result.action = {symbol, search.provenPlace()};
+			return result;
+		}
+	}
+	
+	result.solved = true;
+	result.outcome = Outcome::LOSS;
+	return result;
+}
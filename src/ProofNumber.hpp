@@ -0,0 +1,47 @@
+#ifndef PROOF_NUMBER_HPP_INCLUDED
+#define PROOF_NUMBER_HPP_INCLUDED
+
+#include "Game.hpp"
+#include <cstddef>
+#include <atomic>
+
+// findBestAction() switches to solveExactly() once a board has this many empty
+// spaces or fewer...
+constexpr unsigned int PROOF_NUMBER_EMPTY_THRESHOLD = 9;
+
+// ...but only for searches at least this deep.  Shallow searches are how the
+// easier difficulty levels work, and they're supposed to miss things.
+constexpr unsigned int PROOF_NUMBER_MINIMUM_DEPTH = 4;
+
+// The most nodes a proof-number search may keep in its table.  Each one takes
+// 16 bytes.
+constexpr std::size_t PROOF_NUMBER_NODE_LIMIT = std::size_t(1) << 20;
+
+// Returned by solveExactly().
+struct ProofNumberResult
+{
+	// Whether the search finished.  If it didn't, nothing else here means anything.
+	bool solved = false;
+	
+	// The best outcome symbol can force, assuming both players play perfectly.
+	Outcome outcome = Outcome::LOSS;
+	
+	// An action that forces outcome.  If outcome is a loss, every action loses,
+	// and this is just the first one.
+	Action action;
+	
+	// The total number of nodes generated, over every search that was needed.
+	unsigned int nodeCount = 0;
+};
+
+// Finds the exact outcome of state for symbol, who moves next, with proof-number
+// search.  Since proof-number search only answers yes-or-no questions, this
+// proves or disproves a win first, and then a draw if it has to.  The search gives
+// up if it would need more than nodeLimit nodes, or if cancelled becomes true.
+// state must not be terminal.
+ProofNumberResult solveExactly(const GameState& state,
+                               Symbol symbol,
+                               std::size_t nodeLimit = PROOF_NUMBER_NODE_LIMIT,
+                               const std::atomic<bool>* cancelled = nullptr);
+
+#endif
@@ -0,0 +1,658 @@
+#include "Retrograde.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Every file here is a list of sorted 64-bit entries.  A position's entry is
+// the sum of symbol*3^space over its spaces, where EMPTY, X and O count as 0, 1
+// and 2.  A value's entry is a position's entry times 3, plus the Outcome for
+// the player whose turn it is.  So sorting values also sorts them by position.
+
+namespace
+{
+	constexpr std::uint64_t CHUNK_MAGIC = 0x314B4E4843545454ULL; // "TTTCHNK1"
+	
+	// The most files merged at once.  Anything more gets merged in rounds.
+	constexpr std::size_t MAXIMUM_FAN_IN = 128;
+	
+	constexpr std::size_t READ_BUFFER_SIZE = std::size_t(1) << 16;
+	constexpr std::size_t MINIMUM_CHUNK_ENTRIES = std::size_t(1) << 12;
+	
+	std::runtime_error fileError(const std::string& path, const std::string& problem)
+	{
+		return std::runtime_error("Retrograde solver file " + path + " " + problem);
+	}
+	
+	// Writes a chunk file: a magic number, an entry count, then the differences
+	// between consecutive entries as variable-length integers, 7 bits to a byte.
+	// Since entries are sorted and dense, most differences take a byte or two.
+	class ChunkWriter
+	{
+		public:
+			explicit ChunkWriter(const std::string& path):
+				path(path), output(path, std::ios::binary | std::ios::trunc)
+			{
+				if (!output) throw fileError(path, "couldn't be created.");
+				writeWord(CHUNK_MAGIC);
+				writeWord(0); // Filled in by finish().
+			}
+			
+			void write(const std::uint64_t entry)
+			{
+				std::uint64_t difference = entry - previous;
+				while (difference >= 0x80)
+				{
+					output.rdbuf()->sputc(char(difference | 0x80));
+					difference >>= 7;
+				}
+				output.rdbuf()->sputc(char(difference));
+				previous = entry;
+				count++;
+			}
+			
+			std::uint64_t size() const
+			{
+				return count;
+			}
+			
+			void finish()
+			{
+				output.seekp(sizeof(CHUNK_MAGIC));
+				writeWord(count);
+				output.close();
+				if (!output) throw fileError(path, "couldn't be written.");
+			}
+		
+		private:
+			void writeWord(const std::uint64_t word)
+			{
+				output.write(reinterpret_cast<const char*>(&word), sizeof(word));
+			}
+			
+			std::string path;
+			std::ofstream output;
+			std::uint64_t previous = 0;
+			std::uint64_t count = 0;
+	};
+	
+	class ChunkReader
+	{
+		public:
+			explicit ChunkReader(const std::string& path):
+				path(path), buffer(READ_BUFFER_SIZE)
+			{
+				input.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+				input.open(path, std::ios::binary);
+				std::uint64_t magic = 0;
+				input.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+				input.read(reinterpret_cast<char*>(&remaining), sizeof(remaining));
+				if (!input || magic != CHUNK_MAGIC) throw fileError(path, "isn't a chunk file.");
+			}
+			
+			// Returns false at the end of the chunk.
+			bool next(std::uint64_t& entry)
+			{
+				if (remaining == 0) return false;
+				
+				std::uint64_t difference = 0;
+				for (unsigned int shift = 0;; shift += 7)
+				{
+					const auto byte = input.rdbuf()->sbumpc();
+					if (byte == std::char_traits<char>::eof() || shift > 63)
+						throw fileError(path, "is truncated or damaged.");
+					difference |= std::uint64_t(byte & 0x7F) << shift;
+					if ((byte & 0x80) == 0) break;
+				}
+				previous += difference;
+				entry = previous;
+				remaining--;
+				return true;
+			}
+		
+		private:
+			std::string path;
+			std::vector<char> buffer;
+			std::ifstream input;
+			std::uint64_t previous = 0;
+			std::uint64_t remaining = 0;
+	};
+	
+	// A list of entries spread over numbered chunk files.
+	struct Layer
+	{
+		std::string prefix;
+		std::size_t chunkCount = 0;
+		std::uint64_t entryCount = 0;
+		
+		std::string chunkPath(const std::size_t chunk) const
+		{
+			char number[16];
+			std::snprintf(number, sizeof(number), "-%06zu.chunk", chunk);
+			return prefix + number;
+		}
+		
+		std::string markerPath() const
+		{
+			return prefix + ".done";
+		}
+	};
+	
+	// Reads a layer from start to finish.
+	class LayerReader
+	{
+		public:
+			explicit LayerReader(const Layer& layer):
+				layer(layer)
+			{
+			}
+			
+			bool next(std::uint64_t& entry)
+			{
+				while (!chunk || !chunk->next(entry))
+				{
+					if (nextChunk == layer.chunkCount) return false;
+					chunk.reset(new ChunkReader(layer.chunkPath(nextChunk++)));
+				}
+				return true;
+			}
+		
+		private:
+			const Layer& layer;
+			std::unique_ptr<ChunkReader> chunk;
+			std::size_t nextChunk = 0;
+	};
+	
+	// Writes entries, in order, to a layer, starting a new chunk every chunkEntries
+	// entries so that each chunk can be worked on separately later.
+	class LayerWriter
+	{
+		public:
+			LayerWriter(const std::string& prefix, const std::size_t chunkEntries):
+				chunkEntries(chunkEntries)
+			{
+				layer.prefix = prefix;
+			}
+			
+			void write(const std::uint64_t entry)
+			{
+				if (!chunk || chunk->size() == chunkEntries)
+				{
+					finishChunk();
+					chunk.reset(new ChunkWriter(layer.chunkPath(layer.chunkCount++)));
+				}
+				chunk->write(entry);
+				layer.entryCount++;
+			}
+			
+			Layer finish()
+			{
+				finishChunk();
+				return layer;
+			}
+		
+		private:
+			void finishChunk()
+			{
+				if (chunk) chunk->finish();
+				chunk.reset();
+			}
+			
+			const std::size_t chunkEntries;
+			Layer layer;
+			std::unique_ptr<ChunkWriter> chunk;
+	};
+	
+	// Reads several sorted chunks as one sorted list.
+	class MergedReader
+	{
+		public:
+			explicit MergedReader(const std::vector<std::string>& paths)
+			{
+				for (const auto& path: paths)
+				{
+					readers.emplace_back(new ChunkReader(path));
+					advance(readers.size()-1);
+				}
+			}
+			
+			bool next(std::uint64_t& entry)
+			{
+				if (heads.empty()) return false;
+				const std::size_t reader = heads.top().second;
+				entry = heads.top().first;
+				heads.pop();
+				advance(reader);
+				return true;
+			}
+		
+		private:
+			void advance(const std::size_t reader)
+			{
+				std::uint64_t entry;
+				if (readers[reader]->next(entry)) heads.push({entry, reader});
+			}
+			
+			typedef std::pair<std::uint64_t, std::size_t> Head;
+			std::vector<std::unique_ptr<ChunkReader>> readers;
+			std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+	};
+	
+	// Calls body(index) for every index below count, spread over threadCount
+	// threads.  If any call throws, the first exception is rethrown here once every
+	// thread has stopped.
+	void parallelFor(const std::size_t count, const unsigned int threadCount, const std::function<void(std::size_t)>& body)
+	{
+		std::atomic<std::size_t> nextIndex(0);
+		std::exception_ptr failure;
+		std::mutex failureMutex;
+		const auto work = [&]()
+		{
+			for (std::size_t index; (index = nextIndex++) < count;)
+			{
+				try
+				{
+					body(index);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(failureMutex);
+					if (!failure) failure = std::current_exception();
+					nextIndex = count;
+				}
+			}
+		};
+		
+		std::vector<std::thread> threads;
+		for (unsigned int thread = 1; thread < std::min<std::size_t>(threadCount, count); thread++)
+			threads.emplace_back(work);
+		work();
+		for (auto& thread: threads)
+			thread.join();
+		if (failure) std::rethrow_exception(failure);
+	}
+	
+	double secondsSince(const std::chrono::steady_clock::time_point begin)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	}
+	
+	class RetrogradeSolver
+	{
+		public:
+			explicit RetrogradeSolver(const RetrogradeOptions& options):
+				options(options),
+				spaceCount(options.size*options.size),
+				lines(lineMasksFor(options.size)),
+				runDirectory(options.directory + "/runs")
+			{
+				if (options.size < 3 || options.size > RETROGRADE_MAXIMUM_SIZE)
+					throw std::runtime_error("The retrograde solver only handles boards from 3x3 to "
+					                         + std::to_string(RETROGRADE_MAXIMUM_SIZE) + "x" + std::to_string(RETROGRADE_MAXIMUM_SIZE) + ".");
+				if (options.threadCount == 0)
+					throw std::runtime_error("The retrograde solver needs at least one thread.");
+				
+				// Each thread sorts one chunk at a time, and merges keep a read buffer
+				// for each file.  Sorting needs the chunk, plus the vector's slack.
+				// Merge buffers get at most half the budget, so with many cores and a
+				// small budget, fewer threads run than were asked for.
+				const std::size_t threadMergeMemory = MAXIMUM_FAN_IN*READ_BUFFER_SIZE;
+				if (options.memoryBudget <= threadMergeMemory)
+					throw std::runtime_error("The retrograde solver needs more than "
+					                         + std::to_string(threadMergeMemory >> 20) + " MB of memory.");
+				threadCount = std::max<std::size_t>(1, std::min<std::size_t>(options.threadCount, options.memoryBudget/2/threadMergeMemory));
+				const std::size_t mergeMemory = threadCount*threadMergeMemory;
+				chunkEntries = std::max(MINIMUM_CHUNK_ENTRIES, (options.memoryBudget - mergeMemory)/threadCount/sizeof(std::uint64_t)/2);
+				
+				for (unsigned int space = 0; space < spaceCount; space++)
+					powers.push_back(space == 0 ? 1 : powers.back()*3);
+				
+				checkDirectory();
+			}
+			
+			Outcome solve()
+			{
+				const auto begin = std::chrono::steady_clock::now();
+				
+				// The forward pass: every position reachable from the empty board.
+				std::vector<Layer> positions;
+				for (unsigned int pieces = 0; pieces <= spaceCount; pieces++)
+				{
+					Layer layer = layerNamed("positions", pieces);
+					if (!loadMarker(layer))
+					{
+						const auto layerBegin = std::chrono::steady_clock::now();
+						layer = pieces == 0 ? firstLayer() : nextLayer(positions.back(), pieces);
+						writeMarker(layer);
+						report("found", pieces, layer.entryCount, layerBegin);
+					}
+					if (layer.entryCount == 0) break;
+					positions.push_back(layer);
+				}
+				
+				// The backward pass: each layer's values from the next one's.
+				Layer next;
+				for (std::size_t pieces = positions.size(); pieces-- > 0;)
+				{
+					Layer values = layerNamed("values", pieces);
+					if (!loadMarker(values))
+					{
+						const auto layerBegin = std::chrono::steady_clock::now();
+						values = solveLayer(positions[pieces], next, pieces);
+						writeMarker(values);
+						report("solved", pieces, values.entryCount, layerBegin);
+					}
+					next = values;
+				}
+				
+				std::uint64_t root = 0;
+				LayerReader reader(next);
+				if (next.entryCount != 1 || !reader.next(root) || root/3 != 0)
+					throw fileError(next.markerPath(), "doesn't hold the empty board.");
+				
+				std::uint64_t total = 0;
+				for (const auto& layer: positions) total += layer.entryCount;
+				const Outcome outcome = Outcome(root % 3);
+				if (options.log)
+					*options.log << "Solved all " << total << " positions of " << options.size << "x" << options.size
+					             << " in " << secondsSince(begin) << " s.  X can force a " << outcome << "." << std::endl;
+				return outcome;
+			}
+		
+		private:
+			// Refuses to mix up files from different board sizes, and clears out runs
+			// left behind by an interrupted step.
+			void checkDirectory()
+			{
+				const std::string sizePath = options.directory + "/size";
+				std::ifstream sizeInput(sizePath);
+				unsigned int size = 0;
+				if (sizeInput >> size)
+				{
+					if (size != options.size)
+						throw fileError(sizePath, "says these files are for a " + std::to_string(size) + "x" + std::to_string(size) + " board.");
+				}
+				else
+				{
+					std::ofstream sizeOutput(sizePath);
+					if (!(sizeOutput << options.size << std::endl))
+						throw fileError(sizePath, "couldn't be written.  Does the directory exist?");
+				}
+				
+				mkdir(runDirectory.c_str(), 0777);
+				if (DIR* const directory = opendir(runDirectory.c_str()))
+				{
+					while (const dirent* const entry = readdir(directory))
+						if (entry->d_name[0] != '.') std::remove((runDirectory + "/" + entry->d_name).c_str());
+					closedir(directory);
+				}
+				else throw fileError(runDirectory, "couldn't be opened.");
+			}
+			
+			Layer layerNamed(const std::string& kind, const std::size_t pieces) const
+			{
+				char number[8];
+				std::snprintf(number, sizeof(number), "-%02zu", pieces);
+				Layer layer;
+				layer.prefix = options.directory + "/" + kind + number;
+				return layer;
+			}
+			
+			// Markers hold the entry and chunk counts, and are only written once every
+			// chunk is, so a layer with a marker is complete.
+			bool loadMarker(Layer& layer) const
+			{
+				std::ifstream marker(layer.markerPath());
+				return bool(marker >> layer.entryCount >> layer.chunkCount);
+			}
+			
+			void writeMarker(const Layer& layer) const
+			{
+				std::ofstream marker(layer.markerPath());
+				if (!(marker << layer.entryCount << " " << layer.chunkCount << std::endl))
+					throw fileError(layer.markerPath(), "couldn't be written.");
+			}
+			
+			void report(const char* const verb, const std::size_t pieces, const std::uint64_t count, const std::chrono::steady_clock::time_point begin) const
+			{
+				if (options.log)
+					*options.log << "Layer " << pieces << ": " << verb << " " << count << " positions in "
+					             << secondsSince(begin) << " s (" << count/std::max(secondsSince(begin), 1e-9)
+					             << " positions/sec)." << std::endl;
+			}
+			
+			// The player who moves next in a position with this many pieces.
+			static Symbol moverAt(const std::size_t pieces)
+			{
+				return pieces % 2 == 0 ? Symbol::X : Symbol::O;
+			}
+			
+			void decode(std::uint64_t position, std::uint64_t& xSpaces, std::uint64_t& oSpaces) const
+			{
+				xSpaces = oSpaces = 0;
+				for (unsigned int space = 0; space < spaceCount; space++, position /= 3)
+				{
+					if (position % 3 == 1) xSpaces |= std::uint64_t(1) << space;
+					else if (position % 3 == 2) oSpaces |= std::uint64_t(1) << space;
+				}
+			}
+			
+			// Returns true, and sets outcome for the player to move, if the game is
+			// over.  Only the player who just moved can have a line.
+			bool terminal(const std::uint64_t xSpaces, const std::uint64_t oSpaces, const std::size_t pieces, Outcome& outcome) const
+			{
+				outcome = Outcome::LOSS;
+				if (coversLine(moverAt(pieces) == Symbol::X ? oSpaces : xSpaces, lines)) return true;
+				outcome = Outcome::DRAW;
+				return pieces == spaceCount;
+			}
+			
+			std::string newRunPath()
+			{
+				return runDirectory + "/run-" + std::to_string(runCount++) + ".chunk";
+			}
+			
+			// Sorts entries and writes them to a new run, leaving entries empty.
+			std::string writeRun(std::vector<std::uint64_t>& entries)
+			{
+				std::sort(entries.begin(), entries.end());
+				entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+				const std::string path = newRunPath();
+				ChunkWriter writer(path);
+				for (const std::uint64_t entry: entries)
+					writer.write(entry);
+				writer.finish();
+				entries.clear();
+				return path;
+			}
+			
+			// Calls generate(entry, emit) for every entry of layer, in parallel, and
+			// returns runs holding everything emitted, without duplicates.
+			std::vector<std::string> generateRuns(const Layer& layer, const std::function<void(std::uint64_t, std::vector<std::uint64_t>&)>& generate)
+			{
+				std::vector<std::string> runs;
+				std::mutex runsMutex;
+				parallelFor(layer.chunkCount, threadCount, [&](const std::size_t chunk)
+				{
+					std::vector<std::uint64_t> entries;
+					entries.reserve(chunkEntries);
+					const auto flush = [&]()
+					{
+						const std::string run = writeRun(entries);
+						std::lock_guard<std::mutex> lock(runsMutex);
+						runs.push_back(run);
+					};
+					
+					ChunkReader reader(layer.chunkPath(chunk));
+					std::uint64_t entry;
+					while (reader.next(entry))
+					{
+						generate(entry, entries);
+						if (entries.size() + spaceCount >= chunkEntries) flush();
+					}
+					if (!entries.empty()) flush();
+				});
+				return reduceRuns(runs);
+			}
+			
+			// Merges runs in groups, in parallel, until there are few enough to merge
+			// all at once.
+			std::vector<std::string> reduceRuns(std::vector<std::string> runs)
+			{
+				while (runs.size() > MAXIMUM_FAN_IN)
+				{
+					const std::size_t groupCount = (runs.size() + MAXIMUM_FAN_IN-1)/MAXIMUM_FAN_IN;
+					std::vector<std::string> merged(groupCount);
+					parallelFor(groupCount, threadCount, [&](const std::size_t group)
+					{
+						const auto begin = runs.begin() + group*MAXIMUM_FAN_IN;
+						const std::vector<std::string> inputs(begin, begin + std::min(MAXIMUM_FAN_IN, std::size_t(runs.end() - begin)));
+						merged[group] = newRunPath();
+						
+						MergedReader reader(inputs);
+						ChunkWriter writer(merged[group]);
+						std::uint64_t entry, previous = 0;
+						bool first = true;
+						while (reader.next(entry))
+						{
+							if (first || entry != previous) writer.write(entry);
+							previous = entry;
+							first = false;
+						}
+						writer.finish();
+						removeFiles(inputs);
+					});
+					runs = merged;
+				}
+				return runs;
+			}
+			
+			static void removeFiles(const std::vector<std::string>& paths)
+			{
+				for (const auto& path: paths)
+					std::remove(path.c_str());
+			}
+			
+			Layer firstLayer()
+			{
+				LayerWriter writer(layerNamed("positions", 0).prefix, chunkEntries);
+				writer.write(0);
+				return writer.finish();
+			}
+			
+			// Finds every child of the non-terminal positions in previous.
+			Layer nextLayer(const Layer& previous, const std::size_t pieces)
+			{
+				const std::uint64_t symbol = moverAt(pieces-1) == Symbol::X ? 1 : 2;
+				const auto runs = generateRuns(previous, [&](const std::uint64_t position, std::vector<std::uint64_t>& children)
+				{
+					std::uint64_t xSpaces, oSpaces;
+					Outcome outcome;
+					decode(position, xSpaces, oSpaces);
+					if (terminal(xSpaces, oSpaces, pieces-1, outcome)) return;
+					
+					for (unsigned int space = 0; space < spaceCount; space++)
+						if (((xSpaces | oSpaces) >> space & 1) == 0)
+							children.push_back(position + symbol*powers[space]);
+				});
+				
+				MergedReader reader(runs);
+				LayerWriter writer(layerNamed("positions", pieces).prefix, chunkEntries);
+				std::uint64_t child, previousChild = 0;
+				bool first = true;
+				while (reader.next(child))
+				{
+					if (first || child != previousChild) writer.write(child);
+					previousChild = child;
+					first = false;
+				}
+				removeFiles(runs);
+				return writer.finish();
+			}
+			
+			// Works out the value of every position in positions.  Each of next's
+			// values is passed back, in parallel, to every position it could have
+			// come from, as a value entry for the move that leads to it.  Sorting
+			// those puts each position's moves together, with the best last, so one
+			// pass over positions and the sorted moves finds every value.
+			Layer solveLayer(const Layer& positions, const Layer& next, const std::size_t pieces)
+			{
+				const std::uint64_t symbol = moverAt(pieces) == Symbol::X ? 1 : 2;
+				const auto runs = generateRuns(next, [&](const std::uint64_t value, std::vector<std::uint64_t>& moves)
+				{
+					const std::uint64_t child = value/3;
+					const std::uint64_t outcome = 2 - value%3; // Good for the child's mover is bad for the parent's.
+					
+					std::uint64_t xSpaces, oSpaces;
+					decode(child, xSpaces, oSpaces);
+					const std::uint64_t moved = symbol == 1 ? xSpaces : oSpaces;
+					for (unsigned int space = 0; space < spaceCount; space++)
+						if (moved >> space & 1)
+							moves.push_back((child - symbol*powers[space])*3 + outcome);
+				});
+				
+				MergedReader moveReader(runs);
+				std::uint64_t move = 0;
+				bool moveLeft = moveReader.next(move);
+				
+				LayerReader positionReader(positions);
+				LayerWriter writer(layerNamed("values", pieces).prefix, chunkEntries);
+				std::uint64_t position;
+				while (positionReader.next(position))
+				{
+					// Moves from unreachable positions get skipped over.
+					while (moveLeft && move/3 < position)
+						moveLeft = moveReader.next(move);
+					
+					int best = -1;
+					while (moveLeft && move/3 == position)
+					{
+						best = std::max(best, int(move % 3));
+						moveLeft = moveReader.next(move);
+					}
+					
+					std::uint64_t xSpaces, oSpaces;
+					Outcome outcome;
+					decode(position, xSpaces, oSpaces);
+					if (!terminal(xSpaces, oSpaces, pieces, outcome))
+					{
+						if (best < 0)
+							throw fileError(positions.prefix, "has a position with no children in the next layer.  Remove the solver's files and start over.");
+						outcome = Outcome(best);
+					}
+					writer.write(position*3 + std::uint64_t(outcome));
+				}
+				removeFiles(runs);
+				return writer.finish();
+			}
+			
+			const RetrogradeOptions options;
+			const unsigned int spaceCount;
+			const std::vector<std::uint64_t> lines;
+			const std::string runDirectory;
+			unsigned int threadCount = 0; // options.threadCount, clamped to the memory budget.
+			std::size_t chunkEntries = 0;
+			std::vector<std::uint64_t> powers;
+			std::atomic<unsigned int> runCount{0};
+	};
+}
+
+Outcome solveRetrograde(const RetrogradeOptions& options)
+{
+	RetrogradeSolver solver(options);
+	return solver.solve();
+}
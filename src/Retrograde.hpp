@@ -0,0 +1,42 @@
+#ifndef RETROGRADE_HPP_INCLUDED
+#define RETROGRADE_HPP_INCLUDED
+
+#include "Game.hpp"
+#include <cstddef>
+#include <string>
+#include <iostream>
+
+// The biggest board solveRetrograde() can handle.  Positions are numbered in base 3,
+// and 3^36 is the biggest power of 3 that fits in 64 bits with room to spare.
+constexpr unsigned int RETROGRADE_MAXIMUM_SIZE = 6;
+
+struct RetrogradeOptions
+{
+	unsigned int size = 5;
+	
+	// Where the solver keeps its files.  It must exist already.
+	std::string directory;
+	
+	// About how many bytes of memory the solver may use, in all threads together.
+	std::size_t memoryBudget = std::size_t(1) << 30;
+	
+	// The solver runs fewer threads if each wouldn't get 16 MB of memoryBudget.
+	unsigned int threadCount = 1;
+	
+	// Where progress and throughput get reported, unless it's null.
+	std::ostream* log = &std::cout;
+};
+
+// Solves tic-tac-toe on a size-by-size board, where filling a whole row, column or
+// diagonal wins, and returns the outcome for X from the empty board.
+//
+// Positions are split into layers by how many pieces they have.  A forward pass
+// finds every reachable position, layer by layer, and a backward pass then works out
+// each layer's values from the next one's.  Layers never have to fit in memory:
+// they live in options.directory as sorted, compressed chunk files, which threads
+// read, sort and merge a few at a time.  Every finished layer is marked with a
+// ".done" file, and running the solver again on the same directory carries on from
+// the last one.  Throws std::runtime_error if something goes wrong with the files.
+Outcome solveRetrograde(const RetrogradeOptions& options);
+
+#endif
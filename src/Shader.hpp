@@ -1,26 +1,87 @@
 #ifndef SHADER_HPP_INCLUDED
 #define SHADER_HPP_INCLUDED
 
+// Shapes aren't made of triangles.  Each instance is a quad covering one shape,
+// and the fragment shader works out how much of each pixel the shape covers from
+// its signed distance field.  That means curves cost the same however smooth they
+// are, and edges are antialiased without multisampling.
+
+// The kinds of shape an instance can be.  These have to match the constants in
+// the shaders.
+constexpr GLint SHAPE_CAPSULE = 0; // A line segment with rounded ends, or a circle if the ends are the same.
+constexpr GLint SHAPE_RING = 1;
+constexpr GLint SHAPE_BOX = 2;
+
 constexpr auto VERTEX_SHADER_SOURCE = R"EOF(
 #version 330 core
 #extension all : disable
-layout(location = 0) in vec2 position;
+const int SHAPE_RING = 1;
+layout(location = 0) in vec2 corner;
+layout(location = 1) in int instanceKind;
+layout(location = 2) in vec4 instanceEndpoints;
+layout(location = 3) in vec2 instanceSize;
+layout(location = 4) in vec3 instanceColor;
+uniform vec2 pixelSize;
+out vec2 point;
+flat out int kind;
+flat out vec4 endpoints;
+flat out vec2 size;
+flat out vec3 color;
 void main()
 {
-	gl_Position = vec4(position, 0, 1);
+	// Cover the shape, plus a pixel for the antialiased edge.
+	float extent = instanceSize.x + (instanceKind == SHAPE_RING ? instanceSize.y/2.0 : 0.0);
+	vec2 low = min(instanceEndpoints.xy, instanceEndpoints.zw) - extent - pixelSize;
+	vec2 high = max(instanceEndpoints.xy, instanceEndpoints.zw) + extent + pixelSize;
+	point = mix(low, high, corner);
+	gl_Position = vec4(point, 0.0, 1.0);
+
+	kind = instanceKind;
+	endpoints = instanceEndpoints;
+	size = instanceSize;
+	color = instanceColor;
 }
 )EOF";
 
 constexpr GLuint VERTEX_SHADER_POSITION_LOCATION = 0;
+constexpr GLuint VERTEX_SHADER_INSTANCE_KIND_LOCATION = 1;
+constexpr GLuint VERTEX_SHADER_INSTANCE_ENDPOINTS_LOCATION = 2;
+constexpr GLuint VERTEX_SHADER_INSTANCE_SIZE_LOCATION = 3;
+constexpr GLuint VERTEX_SHADER_INSTANCE_COLOR_LOCATION = 4;
 
 constexpr auto FRAGMENT_SHADER_SOURCE = R"EOF(
 #version 330 core
 #extension all : disable
+const int SHAPE_CAPSULE = 0;
+const int SHAPE_RING = 1;
 layout(location = 0) out vec4 outColor;
-uniform vec3 inColor;
+in vec2 point;
+flat in int kind;
+flat in vec4 endpoints;
+flat in vec2 size;
+flat in vec3 color;
 void main()
 {
-	outColor = vec4(inColor, 1.0f);
+	vec2 from = endpoints.xy;
+	vec2 to = endpoints.zw;
+	float signedDistance;
+	if (kind == SHAPE_CAPSULE)
+	{
+		vec2 along = to - from;
+		float t = dot(along, along) > 0.0 ? clamp(dot(point - from, along)/dot(along, along), 0.0, 1.0) : 0.0;
+		signedDistance = length(point - (from + along*t)) - size.x;
+	}
+	else if (kind == SHAPE_RING)
+		signedDistance = abs(length(point - from) - size.x) - size.y/2.0;
+	else
+	{
+		vec2 outside = abs(point - (from + to)/2.0) - abs(to - from)/2.0;
+		signedDistance = length(max(outside, 0.0)) + min(max(outside.x, outside.y), 0.0);
+	}
+
+	float coverage = clamp(0.5 - signedDistance/fwidth(signedDistance), 0.0, 1.0);
+	if (coverage == 0.0) discard;
+	outColor = vec4(color, coverage);
 }
 )EOF";
 
@@ -28,7 +89,7 @@ struct ShaderProgram
 {
 	GLuint id;
 	GLint vertexAttributeLocation;
-	GLint colorUniformLocation;
+	GLint pixelSizeUniformLocation;
 };
 
 #endif
@@ -0,0 +1,101 @@
+#include "ThreatSpace.hpp"
+
+#include <algorithm>
+
+namespace
+{
+	// Appends symbol's winning move to proof if it has one.
+	bool winsImmediately(const GameState& state, const Symbol symbol, std::vector<Action>& proof)
+	{
+		const auto threats = threatsOf(state, symbol);
+		if (threats.empty()) return false;
+		proof.push_back({symbol, threats.front()});
+		return true;
+	}
+	
+	// Searches for a forced win for symbol, appending it to proof if there is one.
+	bool findForcedWin(const GameState& state, const Symbol symbol, const unsigned int pliesLeft, std::vector<Action>& proof)
+	{
+		if (pliesLeft >= 1 && winsImmediately(state, symbol, proof)) return true;
+		if (pliesLeft < 3) return false; // Our move, the opponent's block and our winning move.
+		
+		// If the opponent is threatening to win, we have to block, and we can
+		// only carry on if the block happens to make a threat of its own.
+		const auto opponentThreats = threatsOf(state, opponentOf(symbol));
+		if (opponentThreats.size() > 1) return false;
+		
+		std::vector<std::size_t> candidates;
+		if (opponentThreats.size() == 1) candidates = opponentThreats;
+		else
+			for (const auto& action: state.possibleActionsFor(symbol))
+				candidates.push_back(action.place);
+		
+		for (const std::size_t place: candidates)
+		{
+			const Action ourAction = {symbol, place};
+			const GameState ourResult = state.apply(ourAction);
+			const auto ourThreats = threatsOf(ourResult, symbol);
+			if (ourThreats.empty()) continue; // Not forcing.
+			
+			proof.push_back(ourAction);
+			
+			// Two threats can't both be blocked.  The opponent can't win first,
+			// either, since they had no threats left after our move.
+			if (ourThreats.size() > 1)
+			{
+				proof.push_back({opponentOf(symbol), ourThreats[0]});
+				proof.push_back({symbol, ourThreats[1]});
+				return true;
+			}
+			
+			const Action block = {opponentOf(symbol), ourThreats.front()};
+			proof.push_back(block);
+			if (findForcedWin(ourResult.apply(block), symbol, pliesLeft-2, proof)) return true;
+			proof.resize(proof.size()-2);
+		}
+		return false;
+	}
+}
+
+std::vector<std::size_t> threatsOf(const GameState& state, const Symbol symbol)
+{
+	std::vector<std::size_t> threats;
+	for (const auto& line: LINE_PLACES)
+	{
+		unsigned int count = 0;
+		unsigned int emptyCount = 0;
+		std::size_t emptyPlace = 0;
+		for (const std::size_t place: line)
+		{
+			if (state.symbols[place] == symbol) count++;
+			else if (state.symbols[place] == Symbol::EMPTY)
+			{
+				emptyCount++;
+				emptyPlace = place;
+			}
+		}
+		
+		// Two lines can share a threat, and it only counts once.
+		if (count == 3 && emptyCount == 1 && std::find(threats.begin(), threats.end(), emptyPlace) == threats.end())
+			threats.push_back(emptyPlace);
+	}
+	return threats;
+}
+
+ThreatSpaceResult searchThreats(const GameState& state, const Symbol symbol, const unsigned int maximumPlies)
+{
+	ThreatSpaceResult result;
+	if (findForcedWin(state, symbol, maximumPlies, result.proof))
+	{
+		result.kind = ThreatSpaceResult::Kind::FORCED_WIN;
+		return result;
+	}
+	
+	const auto opponentThreats = threatsOf(state, opponentOf(symbol));
+	if (maximumPlies >= 2 && opponentThreats.size() == 1)
+	{
+		result.kind = ThreatSpaceResult::Kind::NECESSARY_BLOCK;
+		result.proof.push_back({symbol, opponentThreats.front()});
+	}
+	return result;
+}
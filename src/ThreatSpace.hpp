@@ -0,0 +1,39 @@
+#ifndef THREAT_SPACE_HPP_INCLUDED
+#define THREAT_SPACE_HPP_INCLUDED
+
+#include "Game.hpp"
+#include <cstddef>
+#include <vector>
+
+// Returns every place where symbol could complete a line with one more move.
+// These are symbol's threats: the opponent has to block all of them.
+std::vector<std::size_t> threatsOf(const GameState& state, Symbol symbol);
+
+// Returned by searchThreats().
+struct ThreatSpaceResult
+{
+	enum class Kind
+	{
+		NONE,            // Nothing forced was found; a full search is needed.
+		FORCED_WIN,      // proof is a sequence that wins no matter what the opponent does.
+		NECESSARY_BLOCK  // proof is the only move that doesn't lose right away.
+	};
+	
+	Kind kind = Kind::NONE;
+	
+	// Starts with symbol's move, then alternates between the opponent's forced
+	// replies and symbol's next moves.  A forced win ends with the winning move.
+	std::vector<Action> proof;
+};
+
+// Looks at forcing moves only, for symbol, who moves next.  A forcing move is one
+// that creates a threat, leaving the opponent exactly one move that doesn't lose
+// right away, so the search tree stays tiny.  Only sequences of at most
+// maximumPlies moves, counting both players', are considered.
+//
+// If there's no forced win but the opponent has exactly one threat, that's the
+// necessary block (as long as maximumPlies is at least 2, so that the opponent's
+// reply is within the horizon).
+ThreatSpaceResult searchThreats(const GameState& state, Symbol symbol, unsigned int maximumPlies);
+
+#endif
@@ -0,0 +1,256 @@
+#include "TranspositionTable.hpp"
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Other processes see the same words, so the atomics had better not be
+// implemented with a lock that lives in this process.
+#if ATOMIC_LONG_LOCK_FREE != 2 || ATOMIC_LLONG_LOCK_FREE != 2
+#error "Transposition tables need lock-free 64-bit atomics."
+#endif
+
+namespace
+{
+	constexpr std::uint64_t TABLE_MAGIC = 0x5454545441424C45ULL; // "TTTTABLE"
+	
+	// Bump this whenever the layout of the header or the entries changes.  Tables
+	// made with a different version are refused.
+	constexpr std::uint32_t TABLE_FORMAT_VERSION = 1;
+	
+	// How long to wait for another process to finish setting up a new table.
+	constexpr unsigned int OPEN_TIMEOUT_MS = 1000;
+	
+	// Entry data layout, from the lowest bit up: 16 bits of score (offset so that
+	// it's never negative), 8 bits of depth, 8 bits of maximum depth reached, a
+	// cut-off flag and a lower-bound flag.  The top bit is always set, so that no
+	// entry looks empty.
+	constexpr std::uint64_t VALID_BIT = std::uint64_t(1) << 63;
+	constexpr std::uint64_t CUT_OFF_BIT = std::uint64_t(1) << 32;
+	constexpr std::uint64_t LOWER_BOUND_BIT = std::uint64_t(1) << 33;
+	constexpr int SCORE_OFFSET = 1 << 15;
+	
+	std::uint64_t pack(const TableEntry& entry)
+	{
+		return VALID_BIT
+		       | std::uint64_t(std::uint16_t(entry.score + SCORE_OFFSET))
+		       | std::uint64_t(std::min(entry.depth, 255u)) << 16
+		       | std::uint64_t(std::min(entry.maximumDepth, 255u)) << 24
+		       | (entry.cutOff ? CUT_OFF_BIT : 0)
+		       | (entry.lowerBound ? LOWER_BOUND_BIT : 0);
+	}
+	
+	TableEntry unpack(const std::uint64_t data)
+	{
+		TableEntry entry;
+		entry.score = int(data & 0xFFFF) - SCORE_OFFSET;
+		entry.depth = (data >> 16) & 0xFF;
+		entry.maximumDepth = (data >> 24) & 0xFF;
+		entry.cutOff = data & CUT_OFF_BIT;
+		entry.lowerBound = data & LOWER_BOUND_BIT;
+		return entry;
+	}
+	
+	std::size_t indexOf(std::uint64_t key, const std::size_t slotCount)
+	{
+		key *= 0x9E3779B97F4A7C15ULL; // Spreads out keys that differ by only a few bits.
+		return (key ^ key >> 32) % slotCount;
+	}
+	
+	std::runtime_error tableError(const std::string& name, const std::string& problem)
+	{
+		return std::runtime_error("Transposition table " + name + " " + problem);
+	}
+}
+
+struct TranspositionTable::Header
+{
+	// Written last when a table is set up, so that nobody uses a half-made one.
+	std::atomic<std::uint64_t> magic;
+	std::uint32_t version;
+	std::uint32_t reserved;
+	std::uint64_t entryCount;
+	std::uint64_t padding; // Keeps the slots 16-byte aligned.
+};
+
+struct TranspositionTable::Slot
+{
+	std::atomic<std::uint64_t> check; // The key XORed with data.
+	std::atomic<std::uint64_t> data;
+};
+
+TranspositionTable::TranspositionTable(const std::size_t entryCount)
+{
+	map(-1, sizeof(Header) + entryCount*sizeof(Slot));
+	header->version = TABLE_FORMAT_VERSION;
+	header->entryCount = entryCount;
+	header->magic.store(TABLE_MAGIC);
+	slotCount = entryCount;
+}
+
+TranspositionTable::TranspositionTable(const std::string& name, const std::size_t entryCount)
+{
+	const bool posixName = name.size() > 1 && name[0] == '/' && name.find('/', 1) == std::string::npos;
+	// Tables are only readable and writable by the user who made them, with mode
+	// 0600, since anyone who can write to one can make the AI trust bad results.
+	const auto openTable = [&](const int flags)
+	{
+		return posixName ? shm_open(name.c_str(), flags, 0600) : open(name.c_str(), flags, 0600);
+	};
+	
+	int descriptor = entryCount == 0 ? -1 : openTable(O_RDWR | O_CREAT | O_EXCL);
+	if (descriptor >= 0)
+	{
+		// We made it, so we set it up.
+		const std::size_t size = sizeof(Header) + entryCount*sizeof(Slot);
+		if (ftruncate(descriptor, size) != 0)
+		{
+			const int error = errno;
+			close(descriptor);
+			throw tableError(name, std::string("couldn't be resized: ") + std::strerror(error));
+		}
+		map(descriptor, size);
+		header->version = TABLE_FORMAT_VERSION;
+		header->entryCount = entryCount;
+		header->magic.store(TABLE_MAGIC, std::memory_order_release);
+		slotCount = entryCount;
+		return;
+	}
+	if (entryCount != 0 && errno != EEXIST)
+		throw tableError(name, std::string("couldn't be created: ") + std::strerror(errno));
+	
+	// Someone else made it.  They might not have finished setting it up yet.
+	descriptor = openTable(O_RDWR);
+	if (descriptor < 0)
+		throw tableError(name, std::string("couldn't be opened: ") + std::strerror(errno));
+	
+	struct stat status;
+	for (unsigned int waited = 0;; waited++)
+	{
+		if (fstat(descriptor, &status) != 0 || waited == OPEN_TIMEOUT_MS)
+		{
+			close(descriptor);
+			throw tableError(name, "isn't a transposition table.");
+		}
+		if (std::size_t(status.st_size) >= sizeof(Header)) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	map(descriptor, status.st_size);
+	
+	for (unsigned int waited = 0; header->magic.load(std::memory_order_acquire) != TABLE_MAGIC; waited++)
+	{
+		if (waited == OPEN_TIMEOUT_MS)
+		{
+			unmap();
+			throw tableError(name, "isn't a transposition table.");
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	
+	if (header->version != TABLE_FORMAT_VERSION)
+	{
+		unmap();
+		throw tableError(name, "was made by an incompatible version of this program.  Remove it and try again.");
+	}
+	if (header->entryCount == 0 || header->entryCount > (mappedSize - sizeof(Header))/sizeof(Slot))
+	{
+		unmap();
+		throw tableError(name, "is damaged.  Remove it and try again.");
+	}
+	slotCount = header->entryCount;
+}
+
+TranspositionTable::~TranspositionTable()
+{
+	unmap();
+}
+
+bool TranspositionTable::lookup(const std::uint64_t key, TableEntry& entry) const
+{
+	const Slot& slot = slots[indexOf(key, slotCount)];
+	const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+	const std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+	
+	// An empty slot, a different position or a torn write all fail this.
+	if ((data & VALID_BIT) == 0 || (check ^ data) != key) return false;
+	
+	entry = unpack(data);
+	return true;
+}
+
+void TranspositionTable::store(const std::uint64_t key, const TableEntry& entry)
+{
+	Slot& slot = slots[indexOf(key, slotCount)];
+	const std::uint64_t data = pack(entry);
+	slot.data.store(data, std::memory_order_relaxed);
+	slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+TableStatistics TranspositionTable::statistics() const
+{
+	TableStatistics statistics;
+	statistics.entryCount = slotCount;
+	for (std::size_t index = 0; index < slotCount; index++)
+	{
+		const std::uint64_t data = slots[index].data.load(std::memory_order_relaxed);
+		const std::uint64_t check = slots[index].check.load(std::memory_order_relaxed);
+		if (data == 0 && check == 0) continue;
+		
+		// The key isn't known here, but a torn write almost certainly produces one
+		// that doesn't belong in this slot.
+		if ((data & VALID_BIT) == 0 || indexOf(check ^ data, slotCount) != index)
+		{
+			statistics.tornCount++;
+			continue;
+		}
+		
+		const TableEntry entry = unpack(data);
+		statistics.occupiedCount++;
+		if (entry.lowerBound) statistics.lowerBoundCount++;
+		statistics.depthCounts[std::min<std::size_t>(entry.depth, 7)]++;
+	}
+	return statistics;
+}
+
+void TranspositionTable::map(const int descriptor, const std::size_t size)
+{
+	const int flags = descriptor < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED;
+	void* const address = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, descriptor, 0);
+	const int error = errno;
+	if (descriptor >= 0) close(descriptor);
+	if (address == MAP_FAILED)
+		throw std::runtime_error(std::string("Couldn't map transposition table: ") + std::strerror(error));
+	
+	header = static_cast<Header*>(address);
+	slots = reinterpret_cast<Slot*>(header + 1);
+	mappedSize = size;
+}
+
+void TranspositionTable::unmap()
+{
+	if (header) munmap(header, mappedSize);
+	header = nullptr;
+	slots = nullptr;
+}
+
+std::ostream& operator<<(std::ostream& output, const TableStatistics& statistics)
+{
+	output << "entries: " << statistics.entryCount << ", "
+	       << "occupied: " << statistics.occupiedCount
+	       << " (" << 100.0*statistics.occupiedCount/std::max<std::size_t>(statistics.entryCount, 1) << "%), "
+	       << "lower bounds: " << statistics.lowerBoundCount << ", "
+	       << "torn: " << statistics.tornCount << std::endl
+	       << "occupied entries by depth:";
+	for (std::size_t depth = 0; depth < 8; depth++)
+		output << " " << depth << (depth == 7 ? "+" : "") << ": " << statistics.depthCounts[depth];
+	return output << std::endl;
+}
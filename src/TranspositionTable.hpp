@@ -0,0 +1,85 @@
+#ifndef TRANSPOSITION_TABLE_HPP_INCLUDED
+#define TRANSPOSITION_TABLE_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iostream>
+
+// Big enough for every position the hard difficulty level usually reaches.  Each
+// entry takes 16 bytes.
+constexpr std::size_t DEFAULT_TABLE_ENTRY_COUNT = std::size_t(1) << 20;
+
+// What the table remembers about one search of a position.
+struct TableEntry
+{
+	int score = 0;
+	unsigned int depth = 0;        // The maximumDepth the search was given.
+	unsigned int maximumDepth = 0; // The maximum depth it actually reached.
+	bool cutOff = false;
+	bool lowerBound = false;       // Whether the search was pruned, so score is only a lower bound.
+};
+
+// Counts what's in a table.  See TranspositionTable::statistics().
+struct TableStatistics
+{
+	std::size_t entryCount = 0;
+	std::size_t occupiedCount = 0;
+	std::size_t tornCount = 0; // Entries whose halves came from different writes.
+	std::size_t lowerBoundCount = 0;
+	std::size_t depthCounts[8] = {}; // Occupied entries by depth, with the last counting everything deeper.
+};
+
+// A fixed-size hash table of search results that any number of threads, or
+// processes if the table is shared, can read and write at once without locking.
+// Each entry is two 64-bit words written one after the other, and one of them is
+// the key XORed with the other.  A reader that sees halves of two different
+// writes finds that they don't match the key, and treats the entry as empty.
+// Colliding writes simply replace each other.
+class TranspositionTable
+{
+	public:
+		// Makes a table in this process's own memory.
+		explicit TranspositionTable(std::size_t entryCount = DEFAULT_TABLE_ENTRY_COUNT);
+		
+		// Opens the table called name, creating it with entryCount entries if it
+		// doesn't exist yet, so that every process that opens it shares it.  A name
+		// like "/name" is a POSIX shared memory object, which lasts until it's
+		// removed or the machine restarts; anything else is the path of a file to
+		// map.  A new table is only accessible to the user who made it.  Throws
+		// std::runtime_error if the table can't be opened or was made by an
+		// incompatible version of the program.  If entryCount is 0, the table has to
+		// exist already.
+		TranspositionTable(const std::string& name, std::size_t entryCount);
+		
+		~TranspositionTable();
+		
+		TranspositionTable(const TranspositionTable&) = delete;
+		TranspositionTable& operator=(const TranspositionTable&) = delete;
+		
+		// key must not be 0.  Returns false if there's no entry for key.
+		bool lookup(std::uint64_t key, TableEntry& entry) const;
+		void store(std::uint64_t key, const TableEntry& entry);
+		
+		// Scans the whole table.  Other processes may be writing to it meanwhile,
+		// so the counts are only approximate.
+		TableStatistics statistics() const;
+	
+	private:
+		struct Header;
+		struct Slot;
+		
+		// Maps size bytes of descriptor, or of fresh anonymous memory if descriptor
+		// is -1, and closes descriptor either way.
+		void map(int descriptor, std::size_t size);
+		void unmap();
+		
+		Header* header = nullptr;
+		Slot* slots = nullptr;
+		std::size_t slotCount = 0;
+		std::size_t mappedSize = 0;
+};
+
+std::ostream& operator<<(std::ostream& output, const TableStatistics& statistics);
+
+#endif
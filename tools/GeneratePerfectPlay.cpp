@@ -0,0 +1,58 @@
+// Solves every position in the perfect-play table and writes the table to standard
+// output as C++ source, for PerfectPlay.cpp to #include.  The makefile builds and
+// runs this before compiling the main program.
+
+#include "Game.hpp"
+#include "PerfectPlayIndex.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// Returns the best outcome symbol can force from state, by brute force.  With
+	// only a few empty spaces, there isn't much to search.
+	Outcome solve(const GameState& state, const Symbol symbol)
+	{
+		Outcome best = Outcome::LOSS;
+		for (const auto& action: state.possibleActionsFor(symbol))
+		{
+			const GameState next = state.apply(action);
+			const Outcome outcome = next.terminal() ? next.outcomeFor(symbol) : Outcome(2 - int(solve(next, opponentOf(symbol))));
+			best = std::max(best, outcome);
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	std::vector<std::uint64_t> words((PERFECT_PLAY_ENTRY_COUNT + 31)/32);
+	std::size_t index = 0;
+	bool consistent = true;
+	forEachPerfectPlayPosition([&](const GameState& state)
+	{
+		consistent &= perfectPlayIndex(state) == index;
+		
+		const auto empties = std::count(state.symbols.begin(), state.symbols.end(), Symbol::EMPTY);
+		const Symbol mover = empties % 2 == 0 ? Symbol::X : Symbol::O; // 16 spaces, so an even number left means X's turn.
+		const unsigned int entry = state.terminal() ? PERFECT_PLAY_GAME_OVER : unsigned(solve(state, mover));
+		words[index/32] |= std::uint64_t(entry) << (index%32*2);
+		index++;
+	});
+	
+	if (!consistent || index != PERFECT_PLAY_ENTRY_COUNT)
+	{
+		std::fprintf(stderr, "The perfect-play table's positions aren't in order of index.\n");
+		return 1;
+	}
+	
+	std::printf("// Generated by tools/GeneratePerfectPlay.cpp.  Don't edit.\n");
+	std::printf("const std::uint64_t PERFECT_PLAY_TABLE[%zu] = {\n", words.size());
+	for (std::size_t word = 0; word < words.size(); word++)
+		std::printf("%s0x%016llxULL,%s", word%4 == 0 ? "\t" : "", (unsigned long long)words[word], word%4 == 3 ? "\n" : " ");
+	std::printf("\n};\n");
+	return 0;
+}
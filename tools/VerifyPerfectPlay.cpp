@@ -0,0 +1,12 @@
+// Checks every entry of the perfect-play table compiled into the program against
+// minimax(), like `./main --verify-perfect-play`, but without the GUI, so it builds
+// and runs without SDL, GLEW or a display.  The makefile runs it for `make check`.
+
+#include "PerfectPlay.hpp"
+
+#include <iostream>
+
+int main()
+{
+	return verifyPerfectPlayTable(std::cout) == 0 ? 0 : 1;
+}